@@ -0,0 +1,111 @@
+#include "Benchmark.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+
+#if defined(WINDOWS)
+#	include <Windows.h>
+#	include <Psapi.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Generate a reproducible photo-like image: smooth gradients with some noise, so that encoding
+	//! it gives file sizes close to what cameras produce.
+	//!
+	QImage GenerateImage(const QSize & size)
+	{
+		QImage image(size, QImage::Format_RGB888);
+		uint32_t seed = 0x12345678;
+		for (int y = 0; y < size.height(); ++y)
+		{
+			uchar * line = image.scanLine(y);
+			for (int x = 0; x < size.width(); ++x)
+			{
+				seed = seed * 1664525 + 1013904223;
+				const int noise = static_cast< int >(seed >> 28) - 8;
+				line[x * 3 + 0] = static_cast< uchar >(qBound(0, x * 255 / size.width() + noise, 255));
+				line[x * 3 + 1] = static_cast< uchar >(qBound(0, y * 255 / size.height() + noise, 255));
+				line[x * 3 + 2] = static_cast< uchar >(qBound(0, ((x ^ y) & 0xff) / 2 + 64 + noise, 255));
+			}
+		}
+		return image;
+	}
+
+	//!
+	//! Get the peak resident set size of the process, in kilobytes. It only grows, so it's the peak
+	//! since the process started, not since the last call.
+	//!
+	qint64 GetPeakRss(void)
+	{
+#if defined(WINDOWS)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE)
+		{
+			return 0;
+		}
+		return static_cast< qint64 >(counters.PeakWorkingSetSize / 1024);
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+		{
+			return 0;
+		}
+#	if defined(MACOS)
+		// bytes on macOS, kilobytes everywhere else
+		return static_cast< qint64 >(usage.ru_maxrss / 1024);
+#	else
+		return static_cast< qint64 >(usage.ru_maxrss);
+#	endif
+#endif
+	}
+
+	//!
+	//! Write the results of a suite to the file given by the --json option, if any. The results are
+	//! wrapped with a few information about the run, so that files from different releases or
+	//! machines can be compared.
+	//!
+	//! @return
+	//!		false if the file couldn't be written.
+	//!
+	bool WriteJson(const QCommandLineParser & parser, const QString & suite, const QJsonArray & results)
+	{
+		if (parser.isSet("json") == false)
+		{
+			return true;
+		}
+
+		const QJsonObject root = {
+			{ "suite",		suite },
+			{ "date",		QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+			{ "cpu",		QSysInfo::currentCpuArchitecture() },
+			{ "os",			QSysInfo::prettyProductName() },
+			{ "cores",		QThread::idealThreadCount() },
+			{ "peakRss",	GetPeakRss() },
+			{ "results",	results },
+		};
+
+		QFile file(parser.value("json"));
+		if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false ||
+			file.write(QJsonDocument(root).toJson()) == -1)
+		{
+			QTextStream(stderr) << "failed writing " << file.fileName() << Qt::endl;
+			return false;
+		}
+		return true;
+	}
+
+} // namespace Benchmark
+} // namespace MediaViewer
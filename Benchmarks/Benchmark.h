@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Statistics of a set of timings, in milliseconds
+	//!
+	struct Stats
+	{
+		//! Number of samples
+		int Count = 0;
+
+		//! Mean
+		double Mean = 0.0;
+
+		//! Percentiles
+		double P50 = 0.0;
+		double P95 = 0.0;
+		double P99 = 0.0;
+	};
+
+	//!
+	//! Get the statistics of a set of timings
+	//!
+	inline Stats GetStats(QVector< double > samples)
+	{
+		Stats stats;
+		stats.Count = samples.size();
+		if (samples.isEmpty() == true)
+		{
+			return stats;
+		}
+		std::sort(samples.begin(), samples.end());
+		double total = 0.0;
+		for (double sample : samples)
+		{
+			total += sample;
+		}
+		auto percentile = [&] (double p) {
+			return samples[qMin(static_cast< int >(p * samples.size()), samples.size() - 1)];
+		};
+		stats.Mean = total / samples.size();
+		stats.P50 = percentile(0.50);
+		stats.P95 = percentile(0.95);
+		stats.P99 = percentile(0.99);
+		return stats;
+	}
+
+	//!
+	//! Get the elapsed time of a timer in milliseconds, with sub-millisecond precision
+	//!
+	inline double GetElapsed(const QElapsedTimer & timer)
+	{
+		return timer.nsecsElapsed() / 1000000.0;
+	}
+
+	//!
+	//! Convert statistics to JSON
+	//!
+	inline QJsonObject ToJson(const Stats & stats)
+	{
+		return {
+			{ "count",	stats.Count },
+			{ "mean",	stats.Mean },
+			{ "p50",	stats.P50 },
+			{ "p95",	stats.P95 },
+			{ "p99",	stats.P99 },
+		};
+	}
+
+	// helpers
+	QImage	GenerateImage(const QSize & size);
+	qint64	GetPeakRss(void);
+	bool	WriteJson(const QCommandLineParser & parser, const QString & suite, const QJsonArray & results);
+
+	// the suites
+	void	AddDownscaleOptions(QCommandLineParser & parser);
+	int		RunDownscale(const QCommandLineParser & parser);
+	void	AddJpegOptions(QCommandLineParser & parser);
+	int		RunJpeg(const QCommandLineParser & parser);
+	void	AddModelOptions(QCommandLineParser & parser);
+	int		RunModel(const QCommandLineParser & parser);
+	void	AddPreviewOptions(QCommandLineParser & parser);
+	int		RunPreview(const QCommandLineParser & parser);
+
+} // namespace Benchmark
+} // namespace MediaViewer
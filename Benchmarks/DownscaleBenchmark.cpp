@@ -0,0 +1,158 @@
+#include "Benchmark.h"
+
+#include "ImageProviders/Downscale.h"
+
+#include <QImage>
+#include <QPair>
+#include <QTextStream>
+
+#include <cmath>
+#include <random>
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Reference area-averaging downscale, in double precision. Slow but obviously correct.
+	//!
+	static void Reference(const QImage & source, QImage & destination, int channels)
+	{
+		const double scaleX = source.width() / double(destination.width());
+		const double scaleY = source.height() / double(destination.height());
+		for (int y = 0; y < destination.height(); ++y)
+		{
+			const double y0 = y * scaleY;
+			const double y1 = qMin((y + 1) * scaleY, double(source.height()));
+			uchar * output = destination.scanLine(y);
+			for (int x = 0; x < destination.width(); ++x)
+			{
+				const double x0 = x * scaleX;
+				const double x1 = qMin((x + 1) * scaleX, double(source.width()));
+				for (int c = 0; c < channels; ++c)
+				{
+					double total = 0.0;
+					for (int j = static_cast< int >(y0); j < y1; ++j)
+					{
+						const double coverageY = qMin(j + 1.0, y1) - qMax(double(j), y0);
+						const uchar * input = source.constScanLine(j);
+						for (int i = static_cast< int >(x0); i < x1; ++i)
+						{
+							const double coverageX = qMin(i + 1.0, x1) - qMax(double(i), x0);
+							total += coverageX * coverageY * input[i * channels + c];
+						}
+					}
+					output[x * channels + c] = static_cast< uchar >(std::lround(total / ((x1 - x0) * (y1 - y0))));
+				}
+			}
+		}
+	}
+
+	//!
+	//! Add the options of the downscale suite
+	//!
+	void AddDownscaleOptions(QCommandLineParser & parser)
+	{
+		Q_UNUSED(parser);
+	}
+
+	//!
+	//! Check the downscaler against the reference implementation, then compare its speed with
+	//! QImage::scaled. Returns 1 if the results differ from the reference by more than 1.
+	//!
+	int RunDownscale(const QCommandLineParser & parser)
+	{
+		Q_UNUSED(parser);
+		QTextStream out(stdout);
+		std::mt19937 random(42);
+
+		// correctness, on odd sizes and non integer ratios
+		struct Case { QImage::Format Format; int Channels; };
+		const QVector< Case > formats = {
+			{ QImage::Format_Grayscale8,			1 },
+			{ QImage::Format_RGB888,				3 },
+			{ QImage::Format_ARGB32_Premultiplied,	4 },
+		};
+		const QVector< QPair< QSize, QSize > > sizes = {
+			{ { 640, 480 },		{ 200, 150 } },
+			{ { 101, 79 },		{ 33, 17 } },
+			{ { 17, 13 },		{ 16, 12 } },
+			{ { 1000, 3 },		{ 7, 1 } },
+			{ { 3, 1000 },		{ 1, 9 } },
+			{ { 64, 64 },		{ 64, 64 } },
+			{ { 1920, 1080 },	{ 256, 144 } },
+		};
+		int failures = 0;
+		for (const Case & format : formats)
+		{
+			for (const auto & size : sizes)
+			{
+				QImage source(size.first, format.Format);
+				for (int y = 0; y < source.height(); ++y)
+				{
+					uchar * line = source.scanLine(y);
+					for (int x = 0, count = source.width() * format.Channels; x < count; ++x)
+					{
+						line[x] = static_cast< uchar >(random());
+					}
+				}
+				QImage result(size.second, format.Format), reference(size.second, format.Format);
+				Downscale(source, result);
+				Reference(source, reference, format.Channels);
+
+				int difference = 0;
+				for (int y = 0; y < result.height(); ++y)
+				{
+					for (int x = 0, count = result.width() * format.Channels; x < count; ++x)
+					{
+						difference = qMax(difference, qAbs(result.constScanLine(y)[x] - reference.constScanLine(y)[x]));
+					}
+				}
+				if (difference > 1)
+				{
+					++failures;
+					out << QString("FAILED: %1 channel(s), %2x%3 to %4x%5, max difference %6")
+						.arg(format.Channels)
+						.arg(size.first.width()).arg(size.first.height())
+						.arg(size.second.width()).arg(size.second.height())
+						.arg(difference) << Qt::endl;
+				}
+			}
+		}
+		out << (failures == 0 ? "correctness: ok" : "correctness: FAILED") << Qt::endl << Qt::endl;
+
+		// performances
+		out << QString("%1 %2 %3").arg("", -32).arg("scaled (ms)", 12).arg("Downscale (ms)", 15) << Qt::endl;
+		for (const Case & format : formats)
+		{
+			for (const QSize & size : QVector< QSize >{ { 3840, 2160 }, { 1920, 1080 } })
+			{
+				QImage source(size, format.Format);
+				source.fill(Qt::gray);
+				const QSize target = size.scaled(256, 256, Qt::KeepAspectRatio);
+				QVector< double > qt, ours;
+				for (int i = 0; i < 10; ++i)
+				{
+					QElapsedTimer timer;
+					timer.start();
+					const QImage a = source.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+					qt << GetElapsed(timer);
+					timer.start();
+					const QImage b = Downscale(source, target);
+					ours << GetElapsed(timer);
+				}
+				out << QString("%1 %2 %3")
+					.arg(QString("%1x%2, %3 channel(s)").arg(size.width()).arg(size.height()).arg(format.Channels), -32)
+					.arg(GetStats(qt).P50, 12, 'f', 2)
+					.arg(GetStats(ours).P50, 15, 'f', 2)
+					<< Qt::endl;
+			}
+		}
+
+		return failures == 0 ? 0 : 1;
+	}
+
+} // namespace Benchmark
+} // namespace MediaViewer
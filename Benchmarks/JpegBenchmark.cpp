@@ -0,0 +1,142 @@
+#include "Benchmark.h"
+
+#include "ImageProviders/JpegDecoder.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Generate a synthetic photo-like JPEG corpus (12, 24 and 50 megapixels)
+	//!
+	static QStringList GenerateCorpus(const QString & folder)
+	{
+		QStringList paths;
+		const QVector< QSize > sizes = { { 4240, 2832 }, { 6000, 4000 }, { 8688, 5792 } };
+		for (const QSize & size : sizes)
+		{
+			const QImage image = GenerateImage(size);
+			const QString path = QString("%1/%2x%3.jpg").arg(folder).arg(size.width()).arg(size.height());
+			if (image.save(path, "JPG", 90) == true)
+			{
+				paths << path;
+			}
+		}
+		return paths;
+	}
+
+	//!
+	//! Get the size of a thumbnail which fits in a square box, keeping the aspect ratio
+	//!
+	static QSize GetThumbnailSize(const QSize & imageSize, int box)
+	{
+		return imageSize.scaled(box, box, Qt::KeepAspectRatio);
+	}
+
+	//!
+	//! Add the options of the JPEG suite
+	//!
+	void AddJpegOptions(QCommandLineParser & parser)
+	{
+		parser.addOptions({
+			{ "corpus",	"jpeg: folder containing the JPEG images to decode. A synthetic corpus is generated if not set.", "folder" },
+			{ "box",	"jpeg: size of the thumbnails, in pixels. Default is 256.", "pixels", "256" },
+			{ "runs",	"jpeg: number of times each image is decoded. Default is 5.", "count", "5" },
+		});
+	}
+
+	//!
+	//! Compare the thumbnail generation through QImageReader with our libjpeg based decoder
+	//!
+	int RunJpeg(const QCommandLineParser & parser)
+	{
+		QTextStream out(stdout);
+		const int box = qMax(parser.value("box").toInt(), 1);
+		const int runs = qMax(parser.value("runs").toInt(), 1);
+
+		// get the corpus
+		QTemporaryDir temp;
+		QStringList paths;
+		if (parser.isSet("corpus") == true)
+		{
+			QDir folder(parser.value("corpus"));
+			for (const QString & name : folder.entryList({ "*.jpg", "*.jpeg", "*.JPG", "*.JPEG" }, QDir::Files))
+			{
+				paths << folder.absoluteFilePath(name);
+			}
+		}
+		else
+		{
+			out << "generating corpus..." << Qt::endl;
+			paths = GenerateCorpus(temp.path());
+		}
+		if (paths.isEmpty() == true)
+		{
+			out << "no image to decode" << Qt::endl;
+			return 1;
+		}
+
+		if (DecodeJpeg(paths.first(), { box, box }).isNull() == true)
+		{
+			out << "warning: built without libjpeg, the decoder will always fail" << Qt::endl;
+		}
+
+		// run
+		QVector< double > qtTimes, jpegTimes;
+		out << QString("%1 %2 %3 %4").arg("image", -40).arg("MP", 6).arg("Qt (ms)", 10).arg("libjpeg (ms)", 13) << Qt::endl;
+		for (const QString & path : paths)
+		{
+			const QSize imageSize = QImageReader(path).size();
+			const QSize thumbnailSize = GetThumbnailSize(imageSize, box);
+			QVector< double > qt, jpeg;
+			for (int i = 0; i < runs; ++i)
+			{
+				QElapsedTimer timer;
+
+				// the previous path
+				timer.start();
+				QImageReader reader(path);
+				reader.setScaledSize(thumbnailSize);
+				const QImage reference = reader.read();
+				qt << GetElapsed(timer);
+
+				// the libjpeg one
+				timer.start();
+				const QImage image = DecodeJpeg(path, thumbnailSize);
+				jpeg << GetElapsed(timer);
+
+				Q_UNUSED(reference);
+				Q_UNUSED(image);
+			}
+			out << QString("%1 %2 %3 %4")
+				.arg(QFileInfo(path).fileName(), -40)
+				.arg(imageSize.width() * imageSize.height() / 1000000.0, 6, 'f', 1)
+				.arg(GetStats(qt).P50, 10, 'f', 2)
+				.arg(GetStats(jpeg).P50, 13, 'f', 2)
+				<< Qt::endl;
+			qtTimes << qt;
+			jpegTimes << jpeg;
+		}
+
+		// summary
+		const Stats qt = GetStats(qtTimes);
+		const Stats jpeg = GetStats(jpegTimes);
+		out << Qt::endl;
+		out << QString("%1 %2 %3 %4 %5").arg("", -10).arg("mean", 10).arg("p50", 10).arg("p95", 10).arg("p99", 10) << Qt::endl;
+		out << QString("%1 %2 %3 %4 %5").arg("Qt", -10).arg(qt.Mean, 10, 'f', 2).arg(qt.P50, 10, 'f', 2).arg(qt.P95, 10, 'f', 2).arg(qt.P99, 10, 'f', 2) << Qt::endl;
+		out << QString("%1 %2 %3 %4 %5").arg("libjpeg", -10).arg(jpeg.Mean, 10, 'f', 2).arg(jpeg.P50, 10, 'f', 2).arg(jpeg.P95, 10, 'f', 2).arg(jpeg.P99, 10, 'f', 2) << Qt::endl;
+		out << "speedup: " << QString::number(qt.Mean / qMax(jpeg.Mean, 0.001), 'f', 2) << "x" << Qt::endl;
+		return 0;
+	}
+
+} // namespace Benchmark
+} // namespace MediaViewer
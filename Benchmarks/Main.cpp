@@ -0,0 +1,52 @@
+#include "Benchmark.h"
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QTextStream>
+
+#include <functional>
+
+// header-only libs implementations
+#define MEMORY_TRACKER_IMPLEMENTATION
+#include "CppUtils/MemoryTracker.h"
+
+
+//!
+//! Entry point of the benchmarks.
+//!
+//! Usage: MediaViewerBench <suite> [options]. Use --help to get the list of suites and options.
+//!
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setApplicationName("MediaViewerBench");
+
+	// the available suites
+	const QMap< QString, std::function< int (const QCommandLineParser &) > > suites = {
+		{ "downscale",	MediaViewer::Benchmark::RunDownscale },
+		{ "jpeg",		MediaViewer::Benchmark::RunJpeg },
+		{ "model",		MediaViewer::Benchmark::RunModel },
+		{ "preview",	MediaViewer::Benchmark::RunPreview },
+	};
+
+	// parse the command line
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measure the performances of the MediaViewer's critical paths.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("suite", "The suite to run. One of: " + QStringList(suites.keys()).join(", "));
+	parser.addOption({ "json", "Write the results to this file, as JSON (supported by the model and preview suites).", "file" });
+	MediaViewer::Benchmark::AddDownscaleOptions(parser);
+	MediaViewer::Benchmark::AddJpegOptions(parser);
+	MediaViewer::Benchmark::AddModelOptions(parser);
+	MediaViewer::Benchmark::AddPreviewOptions(parser);
+	parser.process(app);
+
+	// run the suite
+	const QStringList args = parser.positionalArguments();
+	if (args.size() != 1 || suites.contains(args[0]) == false)
+	{
+		QTextStream(stderr) << "unknown or missing suite\n\n" << parser.helpText();
+		return 1;
+	}
+	return suites[args[0]](parser);
+}
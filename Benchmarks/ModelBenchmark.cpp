@@ -0,0 +1,235 @@
+#include "Benchmark.h"
+
+#include "CppUtils/MemoryTracker.h"
+#include "Models/Folder.h"
+#include "Models/Media.h"
+#include "Models/MediaModel.h"
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+#include <random>
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Extensions of the generated files, so that every media type is represented
+	//!
+	static const char * Extensions[] = { "jpg", "png", "tif", "gif", "mp4", "mkv" };
+
+	//!
+	//! Get the name of the nth generated file. Numbers are not zero padded, so that sorting by name
+	//! is not the same as sorting by creation order.
+	//!
+	static QString GetName(int index)
+	{
+		return QString("IMG_%1.%2").arg(index).arg(Extensions[index % (sizeof(Extensions) / sizeof(Extensions[0]))]);
+	}
+
+	//!
+	//! Create a file of the given size
+	//!
+	static bool CreateFile(const QString & path, int size)
+	{
+		QFile file(path);
+		return file.open(QIODevice::WriteOnly) == true && file.write(QByteArray(size, 'x')) == size;
+	}
+
+	//!
+	//! Create a folder containing count medias, with varying sizes
+	//!
+	static bool CreateFolder(const QString & path, int count)
+	{
+		if (QDir().mkpath(path) == false)
+		{
+			return false;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			if (CreateFile(path + "/" + GetName(i), (i * 7919) % 64) == false)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//!
+	//! Run the event loop until a condition is met, or the timeout is reached
+	//!
+	//! @return
+	//!		The elapsed time in milliseconds, or -1 on timeout.
+	//!
+	static double WaitFor(const std::function< bool (void) > & done, int timeout)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		QEventLoop loop;
+		QTimer poll;
+		QObject::connect(&poll, &QTimer::timeout, [&] (void) {
+			if (done() == true || timer.elapsed() > timeout)
+			{
+				loop.quit();
+			}
+		});
+		poll.start(1);
+		if (done() == false)
+		{
+			loop.exec();
+		}
+		return done() == true ? GetElapsed(timer) : -1.0;
+	}
+
+	//!
+	//! Add the options of the model suite
+	//!
+	void AddModelOptions(QCommandLineParser & parser)
+	{
+		parser.addOptions({
+			{ "counts",		"model: comma separated numbers of files. Default is 10000,100000.", "counts", "10000,100000" },
+			{ "folder",		"model: where the folders are created. Use a tmpfs to measure the model rather than the disk. Default is /dev/shm when available.", "folder" },
+			{ "changes",	"model: number of files added then removed to measure the file watcher path. Default is 100.", "count", "100" },
+			{ "lookups",	"model: number of getIndexByPath calls. Default is 1000.", "count", "1000" },
+			{ "timeout",	"model: maximum number of seconds to wait for the file watcher. Default is 600.", "seconds", "600" },
+		});
+	}
+
+	//!
+	//! Measure the media model (initial load, sorts, file watcher updates, lookups) and the folder
+	//! media count on large folders
+	//!
+	int RunModel(const QCommandLineParser & parser)
+	{
+		QTextStream out(stdout);
+		const int changes = qMax(parser.value("changes").toInt(), 1);
+		const int lookups = qMax(parser.value("lookups").toInt(), 1);
+		const int timeout = qMax(parser.value("timeout").toInt(), 1) * 1000;
+		QVector< int > counts;
+		for (const QString & count : parser.value("counts").split(',', Qt::SkipEmptyParts))
+		{
+			if (count.toInt() > 0)
+			{
+				counts << count.toInt();
+			}
+		}
+
+		// where the folders are created
+		QString base = parser.value("folder");
+		if (base.isEmpty() == true && QDir("/dev/shm").exists() == true)
+		{
+			base = "/dev/shm";
+		}
+		QTemporaryDir temp(base.isEmpty() == true ? QDir::tempPath() + "/MediaViewerBench" : base + "/MediaViewerBench");
+		if (temp.isValid() == false)
+		{
+			out << "failed creating the temporary folder" << Qt::endl;
+			return 1;
+		}
+
+		QJsonArray results;
+		auto report = [&] (int count, const QString & name, const Stats & stats) {
+			out << QString("%1 %2 %3 %4 %5 %6")
+				.arg(count, 9).arg(name, -24).arg(stats.Count, 7)
+				.arg(stats.Mean, 12, 'f', 3).arg(stats.P50, 12, 'f', 3).arg(stats.P99, 12, 'f', 3) << Qt::endl;
+			QJsonObject result = ToJson(stats);
+			result["files"]	= count;
+			result["name"]	= name;
+			results << result;
+		};
+		auto single = [] (double time) {
+			return GetStats(time >= 0.0 ? QVector< double >({ time }) : QVector< double >());
+		};
+
+		out << QString("%1 %2 %3 %4 %5 %6").arg("files", 9).arg("operation", -24).arg("count", 7).arg("mean (ms)", 12).arg("p50 (ms)", 12).arg("p99 (ms)", 12) << Qt::endl;
+		for (int count : qAsConst(counts))
+		{
+			const QString folder = QString("%1/%2").arg(temp.path()).arg(count);
+			if (CreateFolder(folder, count) == false)
+			{
+				out << "failed creating " << folder << Qt::endl;
+				return 1;
+			}
+
+			// folder media count (run by the folder tree in the background)
+			{
+				QElapsedTimer timer;
+				timer.start();
+				Folder * tree = MT_NEW Folder(folder);
+				const double time = WaitFor([&] (void) { return tree->GetMediaCount() == count; }, timeout);
+				report(count, "folder count", single(time >= 0.0 ? GetElapsed(timer) : -1.0));
+				MT_DELETE tree;
+			}
+
+			// initial load, which runs in the background
+			MediaModel * model = MT_NEW MediaModel;
+			{
+				QElapsedTimer timer;
+				timer.start();
+				model->SetRoot(folder);
+				const double time = WaitFor([&] (void) { return model->IsLoading() == false; }, timeout);
+				report(count, "load", single(time >= 0.0 ? GetElapsed(timer) : -1.0));
+			}
+
+			// each sort mode, in both orders
+			const QStringList sortNames = { "name", "size", "date", "type" };
+			for (int by = 0; by < sortNames.size(); ++by)
+			{
+				for (int order = 0; order < 2; ++order)
+				{
+					QElapsedTimer timer;
+					timer.start();
+					model->sort(static_cast< MediaModel::SortBy >(by), static_cast< MediaModel::SortOrder >(order));
+					report(count, QString("sort %1 %2").arg(sortNames[by], order == 0 ? "asc" : "desc"), single(GetElapsed(timer)));
+				}
+			}
+			model->sort(MediaModel::SortBy::Name, MediaModel::SortOrder::Ascending);
+
+			// lookups of random paths
+			{
+				std::mt19937 random(42);
+				QVector< double > times;
+				for (int i = 0; i < lookups; ++i)
+				{
+					const QString path = QDir(folder).absoluteFilePath(GetName(static_cast< int >(random() % count)));
+					QElapsedTimer timer;
+					timer.start();
+					const int index = model->getIndexByPath(path);
+					times << GetElapsed(timer);
+					Q_ASSERT(index != -1);
+					Q_UNUSED(index);
+				}
+				report(count, "getIndexByPath", GetStats(times));
+			}
+
+			// incremental add and remove through the file watcher. The time includes the watcher
+			// notification latency
+			{
+				for (int i = 0; i < changes; ++i)
+				{
+					CreateFile(folder + "/" + GetName(count + i), 1);
+				}
+				report(count, "watcher add", single(WaitFor([&] (void) { return model->rowCount() == count + changes; }, timeout)));
+				for (int i = 0; i < changes; ++i)
+				{
+					QFile::remove(folder + "/" + GetName(count + i));
+				}
+				report(count, "watcher remove", single(WaitFor([&] (void) { return model->rowCount() == count; }, timeout)));
+			}
+
+			MT_DELETE model;
+			QDir(folder).removeRecursively();
+		}
+
+		return WriteJson(parser, "model", results) == true ? 0 : 1;
+	}
+
+} // namespace Benchmark
+} // namespace MediaViewer
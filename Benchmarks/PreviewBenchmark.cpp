@@ -0,0 +1,232 @@
+#include "Benchmark.h"
+
+#include "CppUtils/MemoryTracker.h"
+#include "ImageProviders/CacheWarmer.h"
+#include "ImageProviders/MediaPreviewProvider.h"
+#include "Models/Media.h"
+#include "QtUtils/Settings.h"
+
+#include <QDirIterator>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QImage>
+#include <QMap>
+#include <QQuickImageResponse>
+#include <QQuickTextureFactory>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+
+namespace MediaViewer
+{
+namespace Benchmark
+{
+
+	//!
+	//! Generate a reproducible synthetic corpus: the same picture saved in every image format we
+	//! support, at a few common resolutions. Movies can't be generated with Qt alone, use --corpus
+	//! with a folder containing some to benchmark them.
+	//!
+	static QStringList GenerateCorpus(const QString & folder)
+	{
+		QStringList paths;
+		const QVector< QSize > sizes = { { 1280, 720 }, { 3840, 2160 }, { 6000, 4000 } };
+		const QStringList formats = { "jpg", "png", "tif", "gif" };
+		for (const QSize & size : sizes)
+		{
+			const QImage image = GenerateImage(size);
+			for (const QString & format : formats)
+			{
+				const QString path = QString("%1/%2x%3.%4").arg(folder).arg(size.width()).arg(size.height()).arg(format);
+				if (image.save(path, qPrintable(format), format == "jpg" ? 90 : -1) == true)
+				{
+					paths << path;
+				}
+			}
+		}
+		return paths;
+	}
+
+	//!
+	//! Request previews through the provider, keeping at most jobs requests in flight.
+	//!
+	//! @param latencies
+	//!		Receives the time between each request and its response, in milliseconds.
+	//!
+	//! @return
+	//!		The number of failed requests.
+	//!
+	static int Request(MediaPreviewProvider & provider, const QStringList & ids, int jobs, QVector< double > & latencies)
+	{
+		QEventLoop loop;
+		int next = 0;
+		int pending = 0;
+		int failed = 0;
+		std::function< void (void) > request = [&] (void) {
+			while (pending < jobs && next < ids.size())
+			{
+				QElapsedTimer timer;
+				timer.start();
+				QQuickImageResponse * response = provider.requestImageResponse(ids[next++], QSize());
+				++pending;
+				QObject::connect(response, &QQuickImageResponse::finished, &loop, [&, response, timer] (void) {
+					latencies << GetElapsed(timer);
+					QQuickTextureFactory * factory = response->textureFactory();
+					if (factory == nullptr)
+					{
+						++failed;
+					}
+					delete factory;
+					response->deleteLater();
+
+					--pending;
+					request();
+					if (pending == 0)
+					{
+						loop.quit();
+					}
+				});
+			}
+		};
+
+		request();
+		if (pending > 0)
+		{
+			loop.exec();
+		}
+		return failed;
+	}
+
+	//!
+	//! Add the options of the preview suite
+	//!
+	void AddPreviewOptions(QCommandLineParser & parser)
+	{
+		parser.addOptions({
+			{ "medias",	"preview: folder containing the medias. A synthetic corpus is generated if not set.", "folder" },
+			{ "sizes",	"preview: comma separated thumbnail sizes. Default is 200,400.", "sizes", "200,400" },
+			{ "jobs",	"preview: number of previews generated concurrently. Default is the number of cores.", "count" },
+		});
+	}
+
+	//!
+	//! Measure the full preview pipeline (MediaPreviewProvider::requestImageResponse) per format and
+	//! thumbnail size, both cold (nothing cached, previews are generated and stored) and warm (the
+	//! previews are read back from the thumbnail cache by a fresh provider)
+	//!
+	int RunPreview(const QCommandLineParser & parser)
+	{
+		QTextStream out(stdout);
+		const int jobs = parser.isSet("jobs") == true ? qMax(parser.value("jobs").toInt(), 1) : QThread::idealThreadCount();
+		QVector< int > sizes;
+		for (const QString & size : parser.value("sizes").split(',', Qt::SkipEmptyParts))
+		{
+			if (size.toInt() > 20)
+			{
+				sizes << size.toInt();
+			}
+		}
+
+		// get the corpus, grouped by format
+		QTemporaryDir temp;
+		QStringList paths;
+		if (parser.isSet("medias") == true)
+		{
+			QDirIterator it(parser.value("medias"), QDir::Files, QDirIterator::Subdirectories);
+			while (it.hasNext() == true)
+			{
+				paths << it.next();
+			}
+		}
+		else
+		{
+			out << "generating corpus..." << Qt::endl;
+			paths = GenerateCorpus(temp.path());
+		}
+		QMap< QString, QStringList > formats;
+		for (const QString & path : qAsConst(paths))
+		{
+			if (Media::GetType(path) != Media::Type::NotSupported)
+			{
+				formats[QFileInfo(path).suffix().toLower()] << path;
+			}
+		}
+		if (formats.isEmpty() == true || sizes.isEmpty() == true)
+		{
+			out << "nothing to do" << Qt::endl;
+			return 1;
+		}
+
+		// the provider reads its configuration from the settings. Use an empty cache, without
+		// memory cache so that warm runs really read the thumbnail cache
+		QTemporaryDir cache;
+		Settings * settings = MT_NEW Settings;
+		settings->Init("MediaPreviewProvider.UseCache",			true);
+		settings->Init("MediaPreviewProvider.CacheSize",		0);
+		settings->Init("MediaPreviewProvider.MemoryCacheSize",	0);
+		settings->Init("MediaPreviewProvider.MoviePosition",	10);
+		settings->Init("MediaPreviewProvider.MovieCandidates",	1);
+		settings->Init("MediaPreviewProvider.CachePath",		cache.path());
+		Settings::Set("MediaPreviewProvider.UseCache",			true);
+		Settings::Set("MediaPreviewProvider.CacheSize",			0);
+		Settings::Set("MediaPreviewProvider.MemoryCacheSize",	0);
+		Settings::Set("MediaPreviewProvider.CachePath",			cache.path());
+
+		// run
+		QJsonArray results;
+		out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+			.arg("format", -8).arg("size", 6).arg("mode", 6).arg("count", 7)
+			.arg("p50 (ms)", 10).arg("p95 (ms)", 10).arg("p99 (ms)", 10).arg("images/s", 10).arg("cumulative peak RSS (MB)", 25) << Qt::endl;
+		for (const QString & mode : { QString("cold"), QString("warm") })
+		{
+			// a fresh provider per mode, so that nothing is kept in memory between the two
+			auto * provider = MT_NEW MediaPreviewProvider;
+			provider->SetThreadCount(jobs);
+			for (auto format = formats.cbegin(); format != formats.cend(); ++format)
+			{
+				for (int size : qAsConst(sizes))
+				{
+					QStringList ids;
+					for (const QString & path : format.value())
+					{
+						ids << GetPreviewId(path, size);
+					}
+
+					QVector< double > latencies;
+					QElapsedTimer timer;
+					timer.start();
+					const int failed = Request(*provider, ids, jobs, latencies);
+					const double elapsed = GetElapsed(timer);
+
+					const Stats stats = GetStats(latencies);
+					const double throughput = ids.size() * 1000.0 / qMax(elapsed, 0.001);
+					const qint64 cumulativePeakRss = GetPeakRss();
+					out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+						.arg(format.key(), -8).arg(size, 6).arg(mode, 6).arg(stats.Count, 7)
+						.arg(stats.P50, 10, 'f', 2).arg(stats.P95, 10, 'f', 2).arg(stats.P99, 10, 'f', 2)
+						.arg(throughput, 10, 'f', 1).arg(cumulativePeakRss / 1024.0, 25, 'f', 1) << Qt::endl;
+					if (failed > 0)
+					{
+						out << "warning: " << failed << " previews failed" << Qt::endl;
+					}
+
+					QJsonObject result = ToJson(stats);
+					result["format"]			= format.key();
+					result["size"]				= size;
+					result["mode"]				= mode;
+					result["failed"]			= failed;
+					result["imagesPerSecond"]	= throughput;
+					result["cumulativePeakRss"]	= cumulativePeakRss;
+					results << result;
+				}
+			}
+			MT_DELETE provider;
+		}
+
+		MT_DELETE settings;
+		return WriteJson(parser, "preview", results) == true ? 0 : 1;
+	}
+
+} // namespace Benchmark
+} // namespace MediaViewer
@@ -25,13 +25,25 @@ FramelessWindow {
 			folderBrowser.currentFolderPath = initFolder;
 		}
 
-		// if we have an initial media, select it and switch to fullscreen
-		if (initMedia !== "") {
-			selection.selectByPath(initMedia);
-			if (selection.currentMedia) {
-				fullscreenView = true;
-			} else {
-				console.log(`initial media ${initMedia} not found`);
+		// the initial media is selected once the medias are loaded
+		_initMedia = initMedia;
+	}
+
+	// if we have an initial media, select it and switch to fullscreen. This needs to wait until the
+	// media model loaded the initial folder
+	property string _initMedia: ""
+	Connections {
+		target: mediaModel
+		enabled: mainWindow._initMedia !== ""
+		function onLoadingChanged(loading) {
+			if (loading === false) {
+				selection.selectByPath(mainWindow._initMedia);
+				if (selection.currentMedia) {
+					fullscreenView = true;
+				} else {
+					console.log(`initial media ${mainWindow._initMedia} not found`);
+				}
+				mainWindow._initMedia = "";
 			}
 		}
 	}
@@ -27,6 +27,7 @@ Rectangle {
 	property color _background: root.color
 	property int _thumbnailSize: settings.get("Media.ThumbnailSize")
 	property bool _showLabel: settings.get("Media.ShowLabel")
+	property int _scrubFrames: settings.get("Media.ScrubFrames")
 
 	// helper to get back the focus when switching back from fullscreen
 	function forceFocus() {
@@ -54,10 +55,24 @@ Rectangle {
 				case "Media.ShowLabel":
 					root._showLabel = value;
 					break;
+
+				case "Media.ScrubFrames":
+					root._scrubFrames = value;
+					break;
 			}
 		}
 	}
 
+	// loading progress of the current folder
+	ProgressBar {
+		anchors.top: parent.top
+		anchors.left: parent.left
+		anchors.right: parent.right
+		z: 1
+		visible: selection && selection.model ? selection.model.loading : false
+		value: selection && selection.model ? selection.model.progress : 0
+	}
+
 	// use a scroll view to show a scroll bar (GridView is a flickable, so
 	// it doesn't show any scroll bar)
 	Controls.ScrollView {
@@ -78,6 +93,41 @@ Rectangle {
 			// bind the model
 			model: selection ? selection.model : undefined
 
+			// notify the preview provider of what's visible, so that those previews are generated
+			// first, then the ones a screen above and below, then the rest.
+			function updateViewport() {
+				if (!model || count === 0) {
+					return;
+				}
+				const columns = Math.max(1, Math.floor(width / cellWidth));
+				const firstRow = Math.max(0, Math.floor((contentY - originY) / cellHeight));
+				const lastRow = Math.ceil((contentY - originY + height) / cellHeight);
+				const margin = (lastRow - firstRow) * columns;
+				const first = firstRow * columns;
+				const last = lastRow * columns - 1;
+				mediaProvider.setViewport(
+					model.getPaths(first, last),
+					model.getPaths(first - margin, first - 1).concat(model.getPaths(last + 1, last + margin))
+				);
+			}
+
+			// throttle the updates while scrolling
+			Timer {
+				id: viewportTimer
+				interval: 50
+				onTriggered: grid.updateViewport()
+			}
+			function scheduleViewportUpdate() {
+				if (viewportTimer.running === false) {
+					viewportTimer.start();
+				}
+			}
+			onContentYChanged: scheduleViewportUpdate()
+			onWidthChanged: scheduleViewportUpdate()
+			onHeightChanged: scheduleViewportUpdate()
+			onCountChanged: scheduleViewportUpdate()
+			onCellHeightChanged: scheduleViewportUpdate()
+
 			// delegate used to draw an item
 			Component {
 				id: itemDelegate
@@ -86,17 +136,7 @@ Rectangle {
 					id: thumbnailBackground
 					width: grid.cellWidth
 					height: grid.cellHeight
-					color: _background
-
-					// check selection change to update the background
-					Connections {
-						target: selection
-						function onSelectionChanged() {
-							const selected = selection.isSelected(index);
-							thumbnailBackground.color = selected ? _highlight : _background;
-							label.item.color = selected ? _background : "black";
-						}
-					}
+					color: selected ? _highlight : _background
 
 					// the media preview
 					Image {
@@ -109,8 +149,9 @@ Rectangle {
 						anchors.top: parent.top
 						anchors.topMargin: 10
 
-						// generate the preview
-						source: "image://MediaPreview/" + path + "?" + width + "&" + height
+						// generate the preview. The requested size doesn't depend on the label so that
+						// it matches the previews generated by --warm-cache (see CacheWarmer.cpp)
+						source: "image://MediaPreview/" + path + "?" + (grid.cellWidth - 20) + "&" + (grid.cellHeight - 20)
 						asynchronous: true
 						fillMode: Image.PreserveAspectFit
 
@@ -127,9 +168,32 @@ Rectangle {
 							}
 						}
 
+						// hover-scrub: show the frame of the movie strip matching the mouse position.
+						// The strip is a single image, so scrubbing only moves it inside the clip.
+						Loader {
+							active: type === Media.Movie && root._scrubFrames > 0 && hover.containsMouse
+							anchors.centerIn: parent
+							width: image.paintedWidth
+							height: image.paintedHeight
+
+							sourceComponent: Item {
+								clip: true
+
+								Image {
+									id: strip
+									x: -Math.min(Math.floor(hover.mouseX / hover.width * root._scrubFrames), root._scrubFrames - 1) * parent.width
+									width: parent.width * root._scrubFrames
+									height: parent.height
+									source: "image://MediaPreview/" + path + "?" + (grid.cellWidth - 20) + "&" + (grid.cellHeight - 20) + "&frames=" + root._scrubFrames
+									asynchronous: true
+									visible: status === Image.Ready
+								}
+							}
+						}
+
 						// animation overlay if the media can be played
 						Loader {
-							active: image.status === Image.Ready && type !== Media.Image
+							active: image.status === Image.Ready && type !== Media.Image && hover.containsMouse === false
 
 							anchors.centerIn: parent
 							width: grid.cellWidth / 2
@@ -145,6 +209,14 @@ Rectangle {
 						}
 					}
 
+					// track the mouse for the hover-scrub
+					MouseArea {
+						id: hover
+						anchors.fill: image
+						acceptedButtons: Qt.NoButton
+						hoverEnabled: type === Media.Movie && root._scrubFrames > 0
+					}
+
 					// the optional label
 					Loader {
 						id: label
@@ -161,6 +233,7 @@ Rectangle {
 							horizontalAlignment: Text.AlignHCenter
 							elide: Text.ElideMiddle
 							text: name
+							color: selected ? _background : "black"
 						}
 					}
 				}
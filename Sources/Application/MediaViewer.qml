@@ -101,13 +101,13 @@ Rectangle {
 		}
 	}
 
-	// the image viewer
+	// the image viewer. Images are decoded at the screen resolution, and prefetched (see below)
 	Component {
 		id: image
 		Viewers.Image {
 			property var mainWindow: root.mainWindow
 			readonly property var mediaType: Media.Image
-			source: "file:///" + selection.currentMedia.path
+			source: "image://Viewer/" + selection.currentMedia.path
 		}
 	}
 
@@ -121,11 +121,29 @@ Rectangle {
 		}
 	}
 
+	// decode the images around the current one ahead, only when they'll be shown
+	function prefetch() {
+		if (mainWindow.fullscreenView === true && selection.current.valid === true) {
+			const index = selection.current.row,
+				count = viewerProvider.prefetchCount,
+				first = Math.max(index - count, 0);
+			viewerProvider.navigate(index, selection.model.getPaths(first, index + count), first);
+		}
+	}
+
+	// start prefetching when entering full screen
+	Connections {
+		target: mainWindow
+		function onFullscreenViewChanged() { root.prefetch(); }
+	}
+
 	// on selection change, update the viewer if needed
 	Connections {
 		target: selection
 		function onCurrentMediaChanged() {
 			const type = selection.currentMedia ? selection.currentMedia.type : Media.NotSupported;
+			root.prefetch();
+
 			if (viewer.item === null || viewer.item.mediaType !== type) {
 				switch (type) {
 					// Media.Image
@@ -192,6 +192,26 @@ Dialog {
 						}
 					}
 
+					// Number of frames shown when hovering movies in the browser
+					Label {
+						text: "Movie Scrub Frames"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 64
+						value: settings.get("Media.ScrubFrames")
+						onValueModified: settings.set("Media.ScrubFrames", value)
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Number of frames shown when moving the mouse over a movie in the\n" +
+									"media browser view. 0 disables it.";
+						}
+					}
+
 				}
 			}
 
@@ -344,6 +364,129 @@ Dialog {
 						}
 					}
 
+					// maximum size of the cache
+					Label {
+						text: "Cache Size (MB)"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 1024 * 1024
+						stepSize: 256
+						value: settings.get("MediaPreviewProvider.CacheSize")
+						onValueModified: mediaProvider.cacheSize = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Maximum size of the cache. When it's reached, the thumbnails which\n" +
+									"were not used for the longest time are removed. 0 means no limit.";
+						}
+					}
+
+					// maximum size of the decoded thumbnails kept in memory
+					Label {
+						text: "Memory Cache Size (MB)"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 16 * 1024
+						stepSize: 64
+						value: settings.get("MediaPreviewProvider.MemoryCacheSize")
+						onValueModified: mediaProvider.memoryCacheSize = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Maximum size of the recently displayed thumbnails kept in memory,\n" +
+									"so that scrolling back doesn't reload them. 0 disables it.";
+						}
+					}
+
+					// where the movie previews are taken
+					Label {
+						text: "Movie Preview Position (%)"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 100
+						value: settings.get("MediaPreviewProvider.MoviePosition")
+						onValueModified: mediaProvider.moviePosition = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Where movie previews are taken, in percents of the duration of\n" +
+									"the movie. Only affects previews which are not yet in the cache.";
+						}
+					}
+
+					// how many frames to choose from
+					Label {
+						text: "Movie Preview Candidates"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 1
+						to: 16
+						value: settings.get("MediaPreviewProvider.MovieCandidates")
+						onValueModified: mediaProvider.movieCandidates = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Number of frames decoded for each movie preview. The most detailed\n" +
+									"one is used. Higher values give better previews but take longer.";
+						}
+					}
+
+					// how many images the full screen viewer decodes ahead
+					Label {
+						text: "Viewer Prefetch Count"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 16
+						value: settings.get("ViewerProvider.PrefetchCount")
+						onValueModified: viewerProvider.prefetchCount = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Number of images decoded ahead on each side of the current one in\n" +
+									"the full screen viewer. 0 disables it.";
+						}
+					}
+
+					// maximum size of the images decoded for the full screen viewer
+					Label {
+						text: "Viewer Cache Size (MB)"
+						Layout.alignment: Qt.AlignRight
+					}
+					SpinBox {
+						Layout.minimumWidth: 150
+						editable: true
+						from: 0
+						to: 16 * 1024
+						stepSize: 64
+						value: settings.get("ViewerProvider.CacheSize")
+						onValueModified: viewerProvider.cacheSize = value
+						ToolTip.delay: _tooltipDelay
+						ToolTip.visible: hovered
+						ToolTip.text: {
+							return	"Maximum size of the images decoded at screen resolution for the\n" +
+									"full screen viewer.";
+						}
+					}
+
 					Button {
 						Layout.columnSpan: 2
 						Layout.fillWidth: true
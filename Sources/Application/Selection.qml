@@ -3,16 +3,17 @@ import MediaViewer 0.1
 
 
 //
-// Media selection model.
+// Media selection model. The selection itself is stored by the media model (see the `selected`
+// role), and so is the current media, so that it follows the media when rows move (loading,
+// sorting, etc.) This only exposes it as a model index.
 //
 Item {
 	// externally set
 	required property var model
 
 	// selection
-	property var current: { valid: false }
+	readonly property var current: model.getModelIndexByIndex(model.currentIndex)
 	property var currentMedia: undefined
-	property var selection: []
 
 	// check if we have a previous media
 	function hasPrevious(index) {
@@ -43,17 +44,15 @@ Item {
 
 	// check if the given index is selected
 	function isSelected(index) {
-		return indexOf(convertIndex(index)) !== -1;
+		return model.isSelected(convertIndex(index).row);
 	}
 
 	// add to the selection
 	function select(index) {
 		index = convertIndex(index);
-		if (index !== current) {
-			current = convertIndex(index);
-			currentChanged(current);
-			selection.push(current);
-			selectionChanged(selection);
+		if (index.row !== model.currentIndex) {
+			model.currentIndex = index.row;
+			model.select(index.row, index.row, false);
 		}
 	}
 
@@ -68,81 +67,47 @@ Item {
 
 	// remove from the selection
 	function unselect(index) {
-		// compute the index in the current selection
 		index = convertIndex(index);
-		const i = indexOf(index);
-		if (i !== -1) {
-			// update the current
-			if (i > 0) {
-				current = selection[i - 1];
-			} else if (i < selection.length - 1) {
-				current = selection[i + 1];
-			} else {
-				current = { valid: false };
+		if (model.isSelected(index.row) === true) {
+			model.unselect(index.row, index.row);
+			if (index.row === model.currentIndex) {
+				model.currentIndex = model.getFirstSelected();
 			}
-			currentChanged(current);
-
-			// remove from the selection
-			selection.splice(i, 1);
-			selectionChanged(selection);
 		}
 	}
 
 	// overwrite the selection
 	function setCurrent(index) {
 		index = convertIndex(index);
-		if (index !== current) {
-			selection = [ index ];
-			selectionChanged(selection);
-			current = index;
-			currentChanged(current);
+		if (index.row !== model.currentIndex) {
+			if (index.valid === true) {
+				model.select(index.row, index.row, true);
+			} else {
+				model.clearSelection();
+			}
+			model.currentIndex = index.row;
 		}
 	}
 
 	// check if we have a selection
 	function hasSelection() {
-		return selection.length !== 0;
+		return model.selectedCount !== 0;
 	}
 
 	// select everything
 	function selectAll() {
-		selection.length = 0;
-		let index = { valid: false },
-			newIndex = convertIndex(0);
-		while (newIndex.valid === true && index !== newIndex) {
-			selection.push(newIndex);
-			index = newIndex;
-			newIndex = model.getNextModelIndex(index);
-		}
-		current = selection.length !== 0 ? selection[0] : { valid: false };
-		currentChanged(current);
-		selectionChanged(selection);
+		model.selectAll();
+		model.currentIndex = 0;
 	}
 
 	// inverse selection
 	function selectInverse() {
-		let index = { valid: false },
-			newIndex = convertIndex(0);
-		const newSelection = [];
-		while (newIndex.valid === true && index !== newIndex) {
-			if (indexOf(newIndex) === -1) {
-				newSelection.push(newIndex);
-			}
-			index = newIndex;
-			newIndex = model.getNextModelIndex(index);
-		}
-		current = newSelection.length !== 0 ? newSelection[0] : { valid: false };
-		currentChanged(current);
-		selection = newSelection;
-		selectionChanged(selection);
+		model.selectInverse();
+		model.currentIndex = model.getFirstSelected();
 	}
 
 	// extend the selection
 	function extendSelection(index) {
-		// reset the selection
-		selection.length = 0;
-
-		// get the start and end indices
 		index = convertIndex(index);
 		let start = current.valid ? current.row : 0,
 			end = index.row;
@@ -150,22 +115,13 @@ Item {
 			end = start;
 			start = index.row;
 		}
-
-		// add items
-		for (let i = start; i <= end; ++i) {
-			selection.push(convertIndex(i));
-		}
-
-		// update
-		selectionChanged(selection);
+		model.select(start, end, true);
 	}
 
 	// clear the selection
 	function clear() {
-		selection = [];
-		selectionChanged(selection);
-		current = { valid: false };
-		currentChanged(current);
+		model.clearSelection();
+		model.currentIndex = -1;
 	}
 
 	// convert a numerical index (row) into a model index
@@ -173,33 +129,9 @@ Item {
 		return typeof index === "number" ? model.getModelIndexByIndex(index) : index;
 	}
 
-	// get the index of an index in the selection
-	function indexOf(index) {
-		for (let i = 0; i < selection.length; ++i) {
-			if (index.row === selection[i].row) {
-				return i;
-			}
-		}
-		return -1;
-	}
-
 	// return a list of selected paths
 	function getSelectedPaths() {
-		const paths = [];
-		for (let i = 0; i < selection.length; ++i) {
-			paths.push(model.getMedia(selection[i]).path);
-		}
-		return paths;
-	}
-
-	// get the first selected model index
-	function getFirstSelected() {
-		return selection.length > 0 ? selection[0] : { valid: false };
-	}
-
-	// get the last selected model index
-	function getLastSelected() {
-		return selection.length > 0 ? selection[selection.length - 1] : { valid: false };
+		return model.getSelectedPaths();
 	}
 
 	// update the current media
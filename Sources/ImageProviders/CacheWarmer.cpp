@@ -0,0 +1,136 @@
+#include "CacheWarmer.h"
+
+#include "MediaPreviewProvider.h"
+#include "Models/Media.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QQuickImageResponse>
+#include <QQuickTextureFactory>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Get the id used by the media browser to request the preview of a media. The preview fills the
+	//! cell minus its margins, see MediaBrowser.qml.
+	//!
+	//! @param path
+	//!		The media.
+	//!
+	//! @param thumbnailSize
+	//!		The size of the cells of the browser (the Media.ThumbnailSize setting)
+	//!
+	//! @param frames
+	//!		Number of frames of the movie strip, 0 for the preview.
+	//!
+	QString GetPreviewId(const QString & path, int thumbnailSize, int frames)
+	{
+		const QString size = QString::number(thumbnailSize - 20);
+		QString id = path + "?" + size + "&" + size;
+		if (frames > 0)
+		{
+			id += "&frames=" + QString::number(frames);
+		}
+		return id;
+	}
+
+	//!
+	//! Generate the previews of all the medias of a folder, so that browsing it later only hits the
+	//! cache. This runs the same pipeline as the media browser, and blocks until everything is done
+	//! while printing progress and throughput.
+	//!
+	//! @return
+	//!		0 on success, 1 if the folder doesn't exist.
+	//!
+	int WarmCache(MediaPreviewProvider & provider, const CacheWarmerOptions & options)
+	{
+		if (QFileInfo(options.Folder).isDir() == false)
+		{
+			printf("%s is not a folder\n", qPrintable(options.Folder));
+			return 1;
+		}
+
+		// collect the previews to generate
+		QStringList ids;
+		QDirIterator it(options.Folder, QDir::Files, options.Recursive == true ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+		while (it.hasNext() == true)
+		{
+			const QString path = it.next();
+			const Media::Type type = Media::GetType(path);
+			if (type == Media::Type::NotSupported)
+			{
+				continue;
+			}
+			for (int size : options.Sizes)
+			{
+				ids << GetPreviewId(path, size);
+				if (type == Media::Type::Movie && options.ScrubFrames > 0)
+				{
+					ids << GetPreviewId(path, size, options.ScrubFrames);
+				}
+			}
+		}
+		printf("generating %d previews with %d jobs\n", ids.size(), options.Jobs);
+
+		// keep a few requests queued per job, so that the workers are never idle without queueing
+		// everything at once
+		const int maxPending = qMax(options.Jobs, 1) * 4;
+		provider.SetThreadCount(qMax(options.Jobs, 1));
+
+		QEventLoop loop;
+		QElapsedTimer timer;
+		int next = 0;
+		int pending = 0;
+		int done = 0;
+		int failed = 0;
+		std::function< void (void) > request = [&] (void) {
+			while (pending < maxPending && next < ids.size())
+			{
+				QQuickImageResponse * response = provider.requestImageResponse(ids[next++], QSize());
+				++pending;
+				QObject::connect(response, &QQuickImageResponse::finished, &loop, [&, response] (void) {
+					// the caller owns the texture factory
+					QQuickTextureFactory * factory = response->textureFactory();
+					if (factory == nullptr)
+					{
+						++failed;
+					}
+					delete factory;
+					response->deleteLater();
+
+					// progress
+					--pending;
+					if (++done % 100 == 0)
+					{
+						printf("%d / %d (%.1f previews/s)\n", done, ids.size(), done * 1000.0 / qMax(timer.elapsed(), qint64(1)));
+						fflush(stdout);
+					}
+
+					// next batch, or done
+					request();
+					if (pending == 0)
+					{
+						loop.quit();
+					}
+				});
+			}
+		};
+
+		timer.start();
+		request();
+		if (pending > 0)
+		{
+			loop.exec();
+		}
+
+		// stats
+		const double seconds = qMax(timer.elapsed(), qint64(1)) / 1000.0;
+		printf("done: %d previews (%d failed) in %.1f s, %.1f previews/s\n", done, failed, seconds, done / seconds);
+		return 0;
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+
+namespace MediaViewer
+{
+
+	class MediaPreviewProvider;
+
+	//!
+	//! Options of a cache warming run
+	//!
+	struct CacheWarmerOptions
+	{
+		//! The folder containing the medias
+		QString Folder;
+
+		//! Also process the sub folders
+		bool Recursive = false;
+
+		//! The thumbnail sizes, as set in the preferences
+		QVector< int > Sizes;
+
+		//! Number of previews generated concurrently
+		int Jobs = 1;
+
+		//! Number of frames of the movie strips, 0 to skip them
+		int ScrubFrames = 0;
+	};
+
+	// public API
+	QString	GetPreviewId(const QString & path, int thumbnailSize, int frames = 0);
+	int		WarmCache(MediaPreviewProvider & provider, const CacheWarmerOptions & options);
+
+} // namespace MediaViewer
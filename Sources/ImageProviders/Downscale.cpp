@@ -0,0 +1,404 @@
+#include "Downscale.h"
+
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#	define DOWNSCALE_X86
+#	include <immintrin.h>
+#	if defined(MSVC)
+#		include <intrin.h>
+#	endif
+#endif
+
+#if defined(MSVC)
+#	define TARGET_AVX2
+#else
+#	define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+namespace MediaViewer
+{
+
+	//! Precision of the weights. They are stored on signed 16 bits, and a weight can be 1.0
+	static constexpr int WeightBits = 14;
+
+	//! Fractional bits kept by the vertical pass in the intermediate rows
+	static constexpr int IntermediateBits = 8;
+
+	//!
+	//! The source pixels contributing to each destination pixel along one axis
+	//!
+	struct Contributions
+	{
+		//! First contributing source pixel, per destination pixel
+		std::vector< int > First;
+
+		//! Number of contributing source pixels, per destination pixel
+		std::vector< int > Count;
+
+		//! The weights, Stride per destination pixel. The weights of a destination pixel sum to 1
+		std::vector< int16_t > Weights;
+
+		//! Maximum number of contributing pixels
+		int Stride = 0;
+	};
+
+	//!
+	//! Compute the contributions along one axis
+	//!
+	static void GetContributions(int source, int destination, Contributions & contributions)
+	{
+		const double scale = source / double(destination);
+		contributions.Stride = static_cast< int >(std::ceil(scale)) + 1;
+		contributions.First.resize(destination);
+		contributions.Count.resize(destination);
+		contributions.Weights.assign(static_cast< size_t >(destination) * contributions.Stride, 0);
+
+		for (int i = 0; i < destination; ++i)
+		{
+			const double start = i * scale;
+			const double end = qMin((i + 1) * scale, double(source));
+			const int first = qMin(static_cast< int >(start), source - 1);
+			const int last = qBound(first, static_cast< int >(std::ceil(end)) - 1, source - 1);
+			contributions.First[i] = first;
+			contributions.Count[i] = last - first + 1;
+
+			// rounding the cumulated coverage (instead of each coverage) ensures the weights sum to 1
+			int16_t * weights = &contributions.Weights[static_cast< size_t >(i) * contributions.Stride];
+			int previous = 0;
+			for (int j = first; j <= last; ++j)
+			{
+				const double covered = qMin(double(j + 1), end) - start;
+				const int cumulated = static_cast< int >(std::lround(covered / (end - start) * (1 << WeightBits)));
+				weights[j - first] = static_cast< int16_t >(cumulated - previous);
+				previous = cumulated;
+			}
+		}
+	}
+
+	//!
+	//! Accumulate 2 weighted source rows. Scalar version.
+	//!
+	static void AccumulateRows(const uchar * row0, const uchar * row1, int weight0, int weight1, int32_t * accumulator, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			accumulator[i] += weight0 * row0[i] + weight1 * row1[i];
+		}
+	}
+
+#if defined(DOWNSCALE_X86)
+
+	//!
+	//! Accumulate 2 weighted source rows. SSE2 version, part of the x86-64 baseline.
+	//!
+	static void AccumulateRowsSSE2(const uchar * row0, const uchar * row1, int weight0, int weight1, int32_t * accumulator, int count)
+	{
+		const __m128i weights = _mm_set1_epi32((weight1 << 16) | (weight0 & 0xffff));
+		const __m128i zero = _mm_setzero_si128();
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			// interleave the 2 rows, so that each pair of 16 bits values can be multiplied and added
+			// with the pair of weights in one go
+			const __m128i a = _mm_loadu_si128(reinterpret_cast< const __m128i * >(row0 + i));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast< const __m128i * >(row1 + i));
+			const __m128i low = _mm_unpacklo_epi8(a, b);
+			const __m128i high = _mm_unpackhi_epi8(a, b);
+
+			__m128i * output = reinterpret_cast< __m128i * >(accumulator + i);
+			_mm_storeu_si128(output + 0, _mm_add_epi32(_mm_loadu_si128(output + 0), _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weights)));
+			_mm_storeu_si128(output + 1, _mm_add_epi32(_mm_loadu_si128(output + 1), _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weights)));
+			_mm_storeu_si128(output + 2, _mm_add_epi32(_mm_loadu_si128(output + 2), _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weights)));
+			_mm_storeu_si128(output + 3, _mm_add_epi32(_mm_loadu_si128(output + 3), _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weights)));
+		}
+		AccumulateRows(row0 + i, row1 + i, weight0, weight1, accumulator + i, count - i);
+	}
+
+	//!
+	//! Accumulate 2 weighted source rows. AVX2 version.
+	//!
+	TARGET_AVX2 static void AccumulateRowsAVX2(const uchar * row0, const uchar * row1, int weight0, int weight1, int32_t * accumulator, int count)
+	{
+		const __m256i weights = _mm256_set1_epi32((weight1 << 16) | (weight0 & 0xffff));
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast< const __m128i * >(row0 + i)));
+			const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast< const __m128i * >(row1 + i)));
+
+			// unpacking works on 128 bits lanes, so the results are [0-3, 8-11] and [4-7, 12-15]
+			const __m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights);
+			const __m256i high = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights);
+
+			__m256i * output = reinterpret_cast< __m256i * >(accumulator + i);
+			_mm256_storeu_si256(output + 0, _mm256_add_epi32(_mm256_loadu_si256(output + 0), _mm256_permute2x128_si256(low, high, 0x20)));
+			_mm256_storeu_si256(output + 1, _mm256_add_epi32(_mm256_loadu_si256(output + 1), _mm256_permute2x128_si256(low, high, 0x31)));
+		}
+		AccumulateRows(row0 + i, row1 + i, weight0, weight1, accumulator + i, count - i);
+	}
+
+	//!
+	//! Check if the CPU and the OS support AVX2
+	//!
+	static bool HasAVX2(void)
+	{
+#if defined(MSVC)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (osxsave == false || avx == false || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+#endif
+
+	//!
+	//! Get the best row accumulation function for this CPU
+	//!
+	static auto GetAccumulateRows(void)
+	{
+#if defined(DOWNSCALE_X86)
+		static const bool avx2 = HasAVX2();
+		return avx2 == true ? AccumulateRowsAVX2 : AccumulateRowsSSE2;
+#else
+		return AccumulateRows;
+#endif
+	}
+
+	//!
+	//! Downscale raw pixels
+	//!
+	bool Downscale(
+		const uchar * source, int sourceWidth, int sourceHeight, int sourceStride,
+		uchar * destination, int destinationWidth, int destinationHeight, int destinationStride,
+		int channels
+	)
+	{
+		if (source == nullptr || destination == nullptr ||
+			sourceWidth <= 0 || sourceHeight <= 0 || destinationWidth <= 0 || destinationHeight <= 0 ||
+			channels < 1 || channels > 4)
+		{
+			return false;
+		}
+
+		// scratch buffers, reused by subsequent calls on the same thread
+		thread_local Contributions horizontal, vertical;
+		thread_local std::vector< int32_t > accumulator;
+		thread_local std::vector< uint16_t > intermediate;
+		GetContributions(sourceWidth, destinationWidth, horizontal);
+		GetContributions(sourceHeight, destinationHeight, vertical);
+		const int count = sourceWidth * channels;
+		accumulator.resize(count);
+		intermediate.resize(count);
+
+		const auto accumulateRows = GetAccumulateRows();
+		for (int y = 0; y < destinationHeight; ++y)
+		{
+			// vertical pass: accumulate the contributing source rows, 2 at a time
+			std::fill(accumulator.begin(), accumulator.end(), 0);
+			const int first = vertical.First[y];
+			const int rows = vertical.Count[y];
+			const int16_t * weights = &vertical.Weights[static_cast< size_t >(y) * vertical.Stride];
+			for (int i = 0; i < rows; i += 2)
+			{
+				const uchar * row0 = source + static_cast< qsizetype >(first + i) * sourceStride;
+				if (i + 1 < rows)
+				{
+					accumulateRows(row0, row0 + sourceStride, weights[i], weights[i + 1], accumulator.data(), count);
+				}
+				else
+				{
+					accumulateRows(row0, row0, weights[i], 0, accumulator.data(), count);
+				}
+			}
+			constexpr int shift = WeightBits - IntermediateBits;
+			for (int i = 0; i < count; ++i)
+			{
+				intermediate[i] = static_cast< uint16_t >((accumulator[i] + (1 << (shift - 1))) >> shift);
+			}
+
+			// horizontal pass on the reduced row
+			uchar * output = destination + static_cast< qsizetype >(y) * destinationStride;
+			constexpr int finalShift = WeightBits + IntermediateBits;
+			for (int x = 0; x < destinationWidth; ++x)
+			{
+				const uint16_t * input = &intermediate[static_cast< size_t >(horizontal.First[x]) * channels];
+				const int16_t * columnWeights = &horizontal.Weights[static_cast< size_t >(x) * horizontal.Stride];
+				const int columns = horizontal.Count[x];
+				for (int c = 0; c < channels; ++c)
+				{
+					int32_t sum = 0;
+					for (int i = 0; i < columns; ++i)
+					{
+						sum += columnWeights[i] * input[i * channels + c];
+					}
+					output[x * channels + c] = static_cast< uchar >(qMin((sum + (1 << (finalShift - 1))) >> finalShift, 255));
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//!
+	//! Get the number of channels of the formats we can downscale directly, 0 for other formats
+	//!
+	static int GetChannels(QImage::Format format)
+	{
+		switch (format)
+		{
+			case QImage::Format_Grayscale8:
+			case QImage::Format_Alpha8:
+				return 1;
+
+			case QImage::Format_RGB888:
+			case QImage::Format_BGR888:
+				return 3;
+
+			case QImage::Format_RGB32:
+			case QImage::Format_ARGB32_Premultiplied:
+			case QImage::Format_RGBX8888:
+			case QImage::Format_RGBA8888_Premultiplied:
+				return 4;
+
+			default:
+				return 0;
+		}
+	}
+
+	//!
+	//! Downscale an image into a preallocated one
+	//!
+	bool Downscale(const QImage & source, QImage & destination)
+	{
+		const int channels = GetChannels(source.format());
+		if (channels == 0 || source.format() != destination.format())
+		{
+			return false;
+		}
+		return Downscale(
+			source.constBits(), source.width(), source.height(), static_cast< int >(source.bytesPerLine()),
+			destination.bits(), destination.width(), destination.height(), static_cast< int >(destination.bytesPerLine()),
+			channels
+		);
+	}
+
+	//!
+	//! Downscale an image
+	//!
+	QImage Downscale(const QImage & source, const QSize & size)
+	{
+		if (source.isNull() == true || size.isEmpty() == true)
+		{
+			return QImage();
+		}
+		if (size.width() > source.width() || size.height() > source.height())
+		{
+			return source.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		}
+		if (size == source.size())
+		{
+			return source;
+		}
+
+		// convert to a format we support, keeping the alpha channel if needed
+		QImage converted = source;
+		if (GetChannels(source.format()) == 0)
+		{
+			converted = source.convertToFormat(source.hasAlphaChannel() == true ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+		}
+
+		QImage result(size, converted.format());
+		if (Downscale(converted, result) == false)
+		{
+			return source.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		}
+		return result;
+	}
+
+	//!
+	//! Downscale a 4:2:0 YUV frame
+	//!
+	bool DownscaleYUV420(
+		const uchar * luma, int lumaStride, const uchar * u, const uchar * v, int chromaStride, bool interleaved,
+		int width, int height, QImage & destination
+	)
+	{
+		if (luma == nullptr || u == nullptr || v == nullptr || destination.format() != QImage::Format_RGB32)
+		{
+			return false;
+		}
+
+		// reduced planes, reused by subsequent calls on the same thread
+		const int destinationWidth = destination.width();
+		const int destinationHeight = destination.height();
+		const size_t pixels = static_cast< size_t >(destinationWidth) * destinationHeight;
+		thread_local std::vector< uchar > y, chroma;
+		y.resize(pixels);
+		chroma.resize(pixels * 2);
+
+		// the chroma planes are half the size of the luma one (rounded up)
+		const int chromaWidth = (width + 1) / 2;
+		const int chromaHeight = (height + 1) / 2;
+		bool result = Downscale(luma, width, height, lumaStride, y.data(), destinationWidth, destinationHeight, destinationWidth, 1);
+		if (interleaved == true)
+		{
+			// keep the plane order, and swap the components when converting
+			result = result && Downscale(qMin(u, v), chromaWidth, chromaHeight, chromaStride, chroma.data(), destinationWidth, destinationHeight, destinationWidth * 2, 2);
+		}
+		else
+		{
+			// downscale each plane in its half of the buffer
+			result = result &&
+				Downscale(u, chromaWidth, chromaHeight, chromaStride, chroma.data(), destinationWidth, destinationHeight, destinationWidth, 1) &&
+				Downscale(v, chromaWidth, chromaHeight, chromaStride, chroma.data() + pixels, destinationWidth, destinationHeight, destinationWidth, 1);
+		}
+		if (result == false)
+		{
+			return false;
+		}
+
+		// where to find the components of a pixel in the chroma buffer
+		const size_t step = interleaved == true ? 2 : 1;
+		const size_t uOffset = interleaved == true ? (u < v ? 0 : 1) : 0;
+		const size_t vOffset = interleaved == true ? (u < v ? 1 : 0) : pixels;
+
+		// convert, with the usual 8 bits fixed point BT.601 coefficients
+		for (int row = 0; row < destinationHeight; ++row)
+		{
+			QRgb * output = reinterpret_cast< QRgb * >(destination.scanLine(row));
+			const size_t first = static_cast< size_t >(row) * destinationWidth;
+			for (int x = 0; x < destinationWidth; ++x)
+			{
+				const size_t i = first + x;
+				const int c = 298 * (y[i] - 16) + 128;
+				const int d = chroma[i * step + uOffset] - 128;
+				const int e = chroma[i * step + vOffset] - 128;
+				output[x] = qRgb(
+					qBound(0, (c + 409 * e) >> 8, 255),
+					qBound(0, (c - 100 * d - 208 * e) >> 8, 255),
+					qBound(0, (c + 516 * d) >> 8, 255)
+				);
+			}
+		}
+
+		return true;
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Area-averaging downscaler.
+	//!
+	//! Each destination pixel is the average of the source area it covers, with partially covered
+	//! source pixels weighted by their coverage. The vertical pass runs first so that the horizontal
+	//! one only processes the already reduced rows, and it's vectorized (SSE2, or AVX2 when the CPU
+	//! supports it). Weights are fixed point, results are within 1 of an exact area average.
+	//!
+	//! @param source
+	//!		The source pixels.
+	//!
+	//! @param sourceWidth, sourceHeight, sourceStride
+	//!		Size of the source, and number of bytes per source line.
+	//!
+	//! @param destination
+	//!		The preallocated destination pixels.
+	//!
+	//! @param destinationWidth, destinationHeight, destinationStride
+	//!		Size of the destination, and number of bytes per destination line.
+	//!
+	//! @param channels
+	//!		Number of 8 bits channels per pixel, 1 to 4. Channels are averaged independently, so
+	//!		images with an alpha channel should be premultiplied.
+	//!
+	//! @return
+	//!		false if the parameters are invalid.
+	//!
+	bool Downscale(
+		const uchar * source, int sourceWidth, int sourceHeight, int sourceStride,
+		uchar * destination, int destinationWidth, int destinationHeight, int destinationStride,
+		int channels
+	);
+
+	//!
+	//! Downscale an image into a preallocated image of the same format. Supported formats are
+	//! 8 bits grayscale, 24 bits RGB and 32 bits (A)RGB formats (alpha must be premultiplied).
+	//!
+	bool Downscale(const QImage & source, QImage & destination);
+
+	//!
+	//! Downscale an image. Unsupported formats are converted first, and if the requested size is
+	//! not smaller than the image, QImage::scaled is used.
+	//!
+	QImage Downscale(const QImage & source, const QSize & size);
+
+	//!
+	//! Downscale a 4:2:0 YUV frame (BT.601, limited range) into a preallocated RGB32 image.
+	//!
+	//! The luma and chroma planes are downscaled to the destination size first, and the color
+	//! conversion runs on the reduced planes, so full resolution RGB pixels are never produced.
+	//!
+	//! @param luma, lumaStride
+	//!		The luma plane, and its number of bytes per line.
+	//!
+	//! @param u, v, chromaStride
+	//!		The chroma planes, and their number of bytes per line.
+	//!
+	//! @param interleaved
+	//!		true if u and v are interleaved in a single plane (NV12, NV21), in which case u and v
+	//!		point to the first value of their component in that plane.
+	//!
+	//! @param width, height
+	//!		Size of the frame.
+	//!
+	bool DownscaleYUV420(
+		const uchar * luma, int lumaStride, const uchar * u, const uchar * v, int chromaStride, bool interleaved,
+		int width, int height, QImage & destination
+	);
+
+} // namespace MediaViewer
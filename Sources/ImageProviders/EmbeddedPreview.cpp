@@ -0,0 +1,406 @@
+#include "EmbeddedPreview.h"
+
+#include <QFile>
+#include <QSet>
+#include <QTransform>
+#include <QVector>
+
+#include <memory>
+
+
+namespace MediaViewer
+{
+
+	//! TIFF tags we're interested in
+	static constexpr uint16_t TagOrientation		= 0x0112;
+	static constexpr uint16_t TagSubIfds			= 0x014a;
+	static constexpr uint16_t TagExifIfd			= 0x8769;
+	static constexpr uint16_t TagPreviewOffset		= 0x0201;
+	static constexpr uint16_t TagPreviewLength		= 0x0202;
+
+	//! TIFF field types we're interested in
+	static constexpr uint16_t TypeShort				= 3;
+	static constexpr uint16_t TypeLong				= 4;
+	static constexpr uint16_t TypeIfd				= 13;
+
+	//! Limits used to avoid wasting time on corrupted files
+	static constexpr int MaxIfds					= 16;
+	static constexpr int MaxIfdEntries				= 1024;
+	static constexpr int MaxSubIfds					= 8;
+	static constexpr uint32_t MaxPreviewLength		= 32 * 1024 * 1024;
+
+	//!
+	//! Reads TIFF structures (either a TIFF file, or the TIFF block of an EXIF segment)
+	//!
+	class TiffReader
+	{
+
+	public:
+
+		//!
+		//! Constructor
+		//!
+		//! @param file
+		//!		The file.
+		//!
+		//! @param base
+		//!		Offset of the TIFF header in the file. TIFF offsets are relative to it.
+		//!
+		//! @param limit
+		//!		Size of the TIFF block, offsets past it are invalid.
+		//!
+		TiffReader(QFile & file, qint64 base, qint64 limit)
+			: m_File(file)
+			, m_Base(base)
+			, m_Limit(limit)
+			, m_BigEndian(false)
+		{
+		}
+
+		//!
+		//! Read the TIFF header and get the offset of the first IFD
+		//!
+		bool ReadHeader(uint32_t & ifd)
+		{
+			uchar header[8];
+			if (this->Read(0, header, sizeof(header)) == false)
+			{
+				return false;
+			}
+			if (header[0] == 'I' && header[1] == 'I')
+			{
+				m_BigEndian = false;
+			}
+			else if (header[0] == 'M' && header[1] == 'M')
+			{
+				m_BigEndian = true;
+			}
+			else
+			{
+				return false;
+			}
+			if (this->Get16(header + 2) != 42)
+			{
+				return false;
+			}
+			ifd = this->Get32(header + 4);
+			return true;
+		}
+
+		//!
+		//! Walk the IFDs, looking for the orientation and the largest JPEG preview
+		//!
+		void Walk(uint32_t first, uint32_t & offset, uint32_t & length, int & orientation)
+		{
+			QSet< uint32_t > visited;
+			QVector< uint32_t > pending = { first };
+			while (pending.isEmpty() == false && visited.size() < MaxIfds)
+			{
+				uint32_t ifd = pending.takeLast();
+				while (ifd != 0 && visited.contains(ifd) == false && visited.size() < MaxIfds)
+				{
+					visited.insert(ifd);
+
+					// read the entry count
+					uchar count[2];
+					if (this->Read(ifd, count, sizeof(count)) == false)
+					{
+						break;
+					}
+					const int entries = this->Get16(count);
+					if (entries > MaxIfdEntries)
+					{
+						break;
+					}
+
+					// read the entries and the offset of the next IFD
+					QByteArray buffer(entries * 12 + 4, Qt::Uninitialized);
+					uchar * data = reinterpret_cast< uchar * >(buffer.data());
+					if (this->Read(ifd + 2, data, buffer.size()) == false)
+					{
+						break;
+					}
+
+					// process the entries
+					uint32_t previewOffset = 0, previewLength = 0;
+					for (int i = 0; i < entries; ++i)
+					{
+						const uchar * entry = data + i * 12;
+						const uint16_t tag = this->Get16(entry);
+						const uint16_t type = this->Get16(entry + 2);
+						const uint32_t n = this->Get32(entry + 4);
+						const uchar * value = entry + 8;
+						switch (tag)
+						{
+							case TagOrientation:
+								if (type == TypeShort && visited.size() == 1)
+								{
+									orientation = this->Get16(value);
+								}
+								break;
+
+							case TagPreviewOffset:
+								previewOffset = this->GetInteger(type, value);
+								break;
+
+							case TagPreviewLength:
+								previewLength = this->GetInteger(type, value);
+								break;
+
+							case TagExifIfd:
+								pending.push_back(this->GetInteger(type, value));
+								break;
+
+							case TagSubIfds:
+								if (n == 1)
+								{
+									pending.push_back(this->GetInteger(type, value));
+								}
+								else if ((type == TypeLong || type == TypeIfd) && n <= MaxSubIfds)
+								{
+									uchar offsets[MaxSubIfds * 4];
+									if (this->Read(this->Get32(value), offsets, n * 4) == true)
+									{
+										for (uint32_t j = 0; j < n; ++j)
+										{
+											pending.push_back(this->Get32(offsets + j * 4));
+										}
+									}
+								}
+								break;
+						}
+					}
+
+					// keep the largest preview
+					if (previewOffset != 0 && previewLength > length && previewLength <= MaxPreviewLength)
+					{
+						offset = previewOffset;
+						length = previewLength;
+					}
+
+					// next IFD in the chain
+					ifd = this->Get32(data + entries * 12);
+				}
+			}
+		}
+
+		//!
+		//! Read a block of data at the given TIFF offset
+		//!
+		bool Read(qint64 offset, uchar * data, qint64 size)
+		{
+			if (offset < 0 || offset + size > m_Limit)
+			{
+				return false;
+			}
+			return m_File.seek(m_Base + offset) == true && m_File.read(reinterpret_cast< char * >(data), size) == size;
+		}
+
+	private:
+
+		//!
+		//! Get a 16 bits unsigned integer
+		//!
+		uint16_t Get16(const uchar * data) const
+		{
+			return m_BigEndian == true ?
+				static_cast< uint16_t >((data[0] << 8) | data[1]) :
+				static_cast< uint16_t >((data[1] << 8) | data[0]);
+		}
+
+		//!
+		//! Get a 32 bits unsigned integer
+		//!
+		uint32_t Get32(const uchar * data) const
+		{
+			return m_BigEndian == true ?
+				(uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]) :
+				(uint32_t(data[3]) << 24) | (uint32_t(data[2]) << 16) | (uint32_t(data[1]) << 8) | uint32_t(data[0]);
+		}
+
+		//!
+		//! Get the value of an entry holding a single short or long
+		//!
+		uint32_t GetInteger(uint16_t type, const uchar * value) const
+		{
+			return type == TypeShort ? this->Get16(value) : this->Get32(value);
+		}
+
+		//! The file
+		QFile & m_File;
+
+		//! Offset of the TIFF header in the file
+		qint64 m_Base;
+
+		//! Size of the TIFF block
+		qint64 m_Limit;
+
+		//! Byte order
+		bool m_BigEndian;
+
+	};
+
+	//!
+	//! Find the EXIF segment of a JPEG file.
+	//!
+	//! @param base
+	//!		Receives the offset of the TIFF header inside the segment.
+	//!
+	//! @param size
+	//!		Receives the size of the TIFF block.
+	//!
+	static bool FindExif(QFile & file, qint64 & base, qint64 & size)
+	{
+		uchar marker[4];
+		qint64 offset = 2;
+		while (file.seek(offset) == true && file.read(reinterpret_cast< char * >(marker), 4) == 4)
+		{
+			// every segment starts with a marker
+			if (marker[0] != 0xff)
+			{
+				return false;
+			}
+
+			// stop at the start of the compressed data, the EXIF segment is always before
+			if (marker[1] == 0xda || marker[1] == 0xd9)
+			{
+				return false;
+			}
+
+			// check for an APP1 segment with the EXIF signature
+			const int length = (marker[2] << 8) | marker[3];
+			if (marker[1] == 0xe1 && length > 8)
+			{
+				char signature[6];
+				if (file.read(signature, 6) == 6 && memcmp(signature, "Exif\0\0", 6) == 0)
+				{
+					base = offset + 10;
+					size = length - 8;
+					return true;
+				}
+			}
+			offset += 2 + length;
+		}
+		return false;
+	}
+
+	//!
+	//! Locate and walk the EXIF data of a JPEG or TIFF file.
+	//!
+	//! @param reader
+	//!		Receives the reader, which can be used to read the preview.
+	//!
+	//! @param offset
+	//!		Receives the TIFF offset of the largest preview, 0 if there is none.
+	//!
+	//! @param length
+	//!		Receives the size of the largest preview, 0 if there is none.
+	//!
+	//! @param orientation
+	//!		Receives the EXIF orientation, 1 if unknown.
+	//!
+	static bool ReadExif(QFile & file, std::unique_ptr< TiffReader > & reader, uint32_t & offset, uint32_t & length, int & orientation)
+	{
+		orientation = 1;
+		offset = 0;
+		length = 0;
+
+		// locate the TIFF structures: at the start of TIFF files, in the APP1 segment of JPEG files
+		uchar magic[2];
+		if (file.read(reinterpret_cast< char * >(magic), 2) != 2)
+		{
+			return false;
+		}
+		qint64 base = 0, size = file.size();
+		if (magic[0] == 0xff && magic[1] == 0xd8)
+		{
+			if (FindExif(file, base, size) == false)
+			{
+				return false;
+			}
+		}
+		else if ((magic[0] != 'I' || magic[1] != 'I') && (magic[0] != 'M' || magic[1] != 'M'))
+		{
+			return false;
+		}
+
+		// walk the IFDs
+		reader.reset(new TiffReader(file, base, size));
+		uint32_t ifd = 0;
+		if (reader->ReadHeader(ifd) == false)
+		{
+			return false;
+		}
+		reader->Walk(ifd, offset, length, orientation);
+		if (orientation < 1 || orientation > 8)
+		{
+			orientation = 1;
+		}
+		return true;
+	}
+
+	//!
+	//! Get the preview embedded in a file
+	//!
+	bool GetEmbeddedPreview(const QString & path, QByteArray & data, int & orientation)
+	{
+		QFile file(path);
+		std::unique_ptr< TiffReader > reader;
+		uint32_t offset = 0, length = 0;
+		if (file.open(QIODevice::ReadOnly) == false || ReadExif(file, reader, offset, length, orientation) == false)
+		{
+			orientation = 1;
+			return false;
+		}
+		if (length < 4)
+		{
+			return false;
+		}
+
+		// read the preview and check that it's a JPEG stream
+		data.resize(length);
+		if (reader->Read(offset, reinterpret_cast< uchar * >(data.data()), length) == false ||
+			static_cast< uchar >(data[0]) != 0xff ||
+			static_cast< uchar >(data[1]) != 0xd8)
+		{
+			data.clear();
+			return false;
+		}
+		return true;
+	}
+
+	//!
+	//! Get the EXIF orientation of an image
+	//!
+	int GetExifOrientation(const QString & path)
+	{
+		QFile file(path);
+		std::unique_ptr< TiffReader > reader;
+		uint32_t offset = 0, length = 0;
+		int orientation = 1;
+		if (file.open(QIODevice::ReadOnly) == false || ReadExif(file, reader, offset, length, orientation) == false)
+		{
+			return 1;
+		}
+		return orientation;
+	}
+
+	//!
+	//! Apply an EXIF orientation to an image
+	//!
+	QImage ApplyOrientation(const QImage & image, int orientation)
+	{
+		switch (orientation)
+		{
+			case 2: return image.mirrored(true, false);
+			case 3: return image.mirrored(true, true);
+			case 4: return image.mirrored(false, true);
+			case 5: return image.mirrored(true, false).transformed(QTransform().rotate(270));
+			case 6: return image.transformed(QTransform().rotate(90));
+			case 7: return image.mirrored(true, false).transformed(QTransform().rotate(90));
+			case 8: return image.transformed(QTransform().rotate(270));
+			default: return image;
+		}
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <QString>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Get the JPEG preview embedded in a JPEG (EXIF thumbnail) or TIFF file, without decoding the
+	//! image itself. Only a few small reads are needed since the EXIF data is located at the start
+	//! of the file.
+	//!
+	//! @param path
+	//!		The image file.
+	//!
+	//! @param data
+	//!		Receives the JPEG encoded preview. When there are several, the largest one is used.
+	//!
+	//! @param orientation
+	//!		Receives the EXIF orientation of the image (1 to 8), which also applies to the preview.
+	//!		Defaults to 1 when the image doesn't specify it.
+	//!
+	//! @return
+	//!		true if a preview was found.
+	//!
+	bool GetEmbeddedPreview(const QString & path, QByteArray & data, int & orientation);
+
+	//!
+	//! Get the EXIF orientation (1 to 8) of a JPEG or TIFF file, 1 if it doesn't specify any.
+	//!
+	int GetExifOrientation(const QString & path);
+
+	//!
+	//! Apply an EXIF orientation (1 to 8) to an image.
+	//!
+	QImage ApplyOrientation(const QImage & image, int orientation);
+
+} // namespace MediaViewer
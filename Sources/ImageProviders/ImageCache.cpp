@@ -0,0 +1,88 @@
+#include "ImageCache.h"
+
+#include <QMutexLocker>
+
+#include <limits>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Get the cost of an image, in kilobytes
+	//!
+	static int GetCost(const QImage & image)
+	{
+		return static_cast< int >(image.sizeInBytes() / 1024) + 1;
+	}
+
+	//!
+	//! Constructor
+	//!
+	ImageCache::ImageCache(void)
+	{
+	}
+
+	//!
+	//! Get an image.
+	//!
+	//! @param source
+	//!		The current state of the source media. If it doesn't match the one stored with the image,
+	//!		the image is stale and this method returns false.
+	//!
+	//! @return
+	//!		true if the image was in the cache.
+	//!
+	bool ImageCache::Get(uint64_t key, const ThumbnailCache::Source & source, QImage & image) const
+	{
+		QMutexLocker lock(&m_Mutex);
+		const Entry * cached = m_Images.object(key);
+		if (cached == nullptr || cached->Source.Size != source.Size || cached->Source.Date != source.Date)
+		{
+			return false;
+		}
+		image = cached->Image;
+		return true;
+	}
+
+	//!
+	//! Add an image, evicting the least recently used ones if needed.
+	//!
+	void ImageCache::Put(uint64_t key, const ThumbnailCache::Source & source, const QImage & image)
+	{
+		if (image.isNull() == true)
+		{
+			return;
+		}
+		QMutexLocker lock(&m_Mutex);
+		m_Images.insert(key, new Entry { image, source }, GetCost(image));
+	}
+
+	//!
+	//! Remove all the images
+	//!
+	void ImageCache::Clear(void)
+	{
+		QMutexLocker lock(&m_Mutex);
+		m_Images.clear();
+	}
+
+	//!
+	//! Get the maximum number of bytes used by the images
+	//!
+	uint64_t ImageCache::GetBudget(void) const
+	{
+		QMutexLocker lock(&m_Mutex);
+		return static_cast< uint64_t >(m_Images.maxCost()) * 1024;
+	}
+
+	//!
+	//! Set the maximum number of bytes used by the images
+	//!
+	void ImageCache::SetBudget(uint64_t budget)
+	{
+		QMutexLocker lock(&m_Mutex);
+		m_Images.setMaxCost(static_cast< int >(qMin< uint64_t >(budget / 1024, std::numeric_limits< int >::max())));
+	}
+
+} // namespace MediaViewer
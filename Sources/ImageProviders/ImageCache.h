@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ThumbnailCache.h"
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Thread safe, size bounded cache of decoded images.
+	//!
+	//! This sits in front of the thumbnail store: when the media browser's delegates are recycled
+	//! while scrolling, thumbnails which were recently shown are served from memory without touching
+	//! the disk or decoding anything. Images are implicitly shared, so serving one doesn't copy it.
+	//!
+	//! Each image is stored with the state of its source media, and is only served while the source
+	//! didn't change, like the thumbnails of the store.
+	//!
+	class ImageCache
+	{
+
+	public:
+
+		ImageCache(void);
+
+		// public API
+		bool		Get(uint64_t key, const ThumbnailCache::Source & source, QImage & image) const;
+		void		Put(uint64_t key, const ThumbnailCache::Source & source, const QImage & image);
+		void		Clear(void);
+		uint64_t	GetBudget(void) const;
+		void		SetBudget(uint64_t budget);
+
+	private:
+
+		//!
+		//! A cached image.
+		//!
+		struct Entry
+		{
+			//! The image
+			QImage Image;
+
+			//! State of the source media when the image was generated
+			ThumbnailCache::Source Source;
+		};
+
+		//! Protects the images
+		mutable QMutex m_Mutex;
+
+		//! The images. Costs are in kilobytes, since QCache uses int costs.
+		mutable QCache< uint64_t, Entry > m_Images;
+
+	};
+
+}
@@ -9,8 +9,19 @@ namespace MediaViewer
 	//!
 	//! Constructor
 	//!
-	ImageResponse::ImageResponse(RunCallbackType && run,  QThreadPool * pool)
+	//! @param run
+	//!		The function generating the image.
+	//!
+	//! @param pool
+	//!		The pool in which the function is run.
+	//!
+	//! @param priority
+	//!		The initial priority in the pool. Higher priorities are run first.
+	//!
+	ImageResponse::ImageResponse(RunCallbackType && run,  QThreadPool * pool, int priority)
 		: m_Run(run)
+		, m_Pool(pool)
+		, m_Priority(priority)
 		, m_Cancel(false)
 	{
 		// thread pool automatically delete jobs when done, but this is also an image response which
@@ -19,7 +30,67 @@ namespace MediaViewer
 		setAutoDelete(false);
 
 		// auto-start
-		pool->start(this);
+		pool->start(this, priority);
+	}
+
+	//!
+	//! Constructor for an image which is already available. The response is immediately finished.
+	//!
+	ImageResponse::ImageResponse(const QImage & image)
+		: m_Cancel(false)
+		, m_Image(image)
+	{
+		// the engine connects to our finished signal after we're returned, so it needs to be deferred
+		QMetaObject::invokeMethod(this, [this] (void) { emit finished(); }, Qt::QueuedConnection);
+	}
+
+	//!
+	//! Destructor
+	//!
+	ImageResponse::~ImageResponse(void)
+	{
+		if (m_Destroyed)
+		{
+			m_Destroyed(this);
+		}
+
+		// never leave a dangling job in the pool
+		if (m_Pool != nullptr)
+		{
+			m_Pool->tryTake(this);
+		}
+	}
+
+	//!
+	//! Change the priority of the response. This only has an effect if the response is still
+	//! waiting in the pool, in which case it's re-queued with the new priority.
+	//!
+	void ImageResponse::SetPriority(int priority)
+	{
+		if (m_Pool != nullptr && priority != m_Priority && m_Pool->tryTake(this) == true)
+		{
+			m_Priority = priority;
+			m_Pool->start(this, priority);
+		}
+	}
+
+	//!
+	//! Set a function called when the response is destroyed. It's called before anything is
+	//! released, so it can be used to safely unregister the response.
+	//!
+	void ImageResponse::SetDestroyedCallback(DestroyedCallbackType && callback)
+	{
+		m_Destroyed = callback;
+	}
+
+	//!
+	//! Finish a response which is not run in a pool, once its image is available. Can be called from
+	//! any thread.
+	//!
+	void ImageResponse::Finish(const QImage & image)
+	{
+		m_Image = image;
+		emit finished();
 	}
 
 	//!
@@ -36,6 +107,12 @@ namespace MediaViewer
 	void ImageResponse::cancel(void)
 	{
 		m_Cancel = true;
+
+		// if it's not started yet, drop it right away. The response still needs to be finished
+		if (m_Pool != nullptr && m_Pool->tryTake(this) == true)
+		{
+			QMetaObject::invokeMethod(this, [this] (void) { emit finished(); }, Qt::QueuedConnection);
+		}
 	}
 
 	//!
@@ -43,7 +120,7 @@ namespace MediaViewer
 	//!
 	void ImageResponse::run(void)
 	{
-		m_Image = m_Run(m_Cancel);
+		m_Image = m_Cancel == false ? m_Run(m_Cancel) : QImage();
 		emit finished();
 	}
 
@@ -21,9 +21,19 @@ namespace MediaViewer
 		//! The type of the run callback function
 		typedef std::function< QImage (std::atomic_bool &) > RunCallbackType;
 
+		//! The type of the callback invoked when the response is destroyed
+		typedef std::function< void (ImageResponse *) > DestroyedCallbackType;
+
 		// constructors
 		ImageResponse(void) = default;
-		ImageResponse(RunCallbackType && run, QThreadPool * pool = QThreadPool::globalInstance());
+		ImageResponse(RunCallbackType && run, QThreadPool * pool = QThreadPool::globalInstance(), int priority = 0);
+		ImageResponse(const QImage & image);
+		~ImageResponse(void);
+
+		// public API
+		void	SetPriority(int priority);
+		void	SetDestroyedCallback(DestroyedCallbackType && callback);
+		void	Finish(const QImage & image);
 
 		// reimplemented from QQuickImageResponse
 		QQuickTextureFactory *	textureFactory(void) const final;
@@ -37,6 +47,15 @@ namespace MediaViewer
 		//! The callback to run to get the image
 		RunCallbackType m_Run;
 
+		//! Called when the response is destroyed
+		DestroyedCallbackType m_Destroyed;
+
+		//! The pool in which the response is run
+		QThreadPool * m_Pool = nullptr;
+
+		//! The priority of the response in the pool
+		int m_Priority = 0;
+
 		//! True when the response needs to be cancelled
 		std::atomic_bool m_Cancel;
 
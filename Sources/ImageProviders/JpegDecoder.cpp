@@ -0,0 +1,171 @@
+#include "JpegDecoder.h"
+
+#include "Downscale.h"
+
+#include <QFile>
+
+#if defined(HAS_LIBJPEG)
+#	include <csetjmp>
+#	include <cstdio>
+#	include <jpeglib.h>
+#endif
+
+
+namespace MediaViewer
+{
+
+#if defined(HAS_LIBJPEG)
+
+	//!
+	//! libjpeg error manager which jumps back to the decoder instead of exiting
+	//!
+	struct ErrorManager
+	{
+		//! The libjpeg error manager. Must be first, libjpeg only knows about this one
+		jpeg_error_mgr Manager;
+
+		//! Where to jump on errors
+		jmp_buf Jump;
+	};
+
+	//!
+	//! Called by libjpeg on fatal errors
+	//!
+	static void OnError(j_common_ptr info)
+	{
+		longjmp(reinterpret_cast< ErrorManager * >(info->err)->Jump, 1);
+	}
+
+	//!
+	//! Called by libjpeg for warnings and traces. We don't want libjpeg to write on stderr.
+	//!
+	static void OnMessage(j_common_ptr info)
+	{
+		Q_UNUSED(info);
+	}
+
+	//!
+	//! Decode a JPEG stream. This is kept separate from DecodeJpeg because of setjmp: nothing with
+	//! a destructor is allowed here, and the image must not be a local of this function.
+	//!
+	static bool Decode(const uchar * data, qint64 size, const QSize & target, QImage & image)
+	{
+		jpeg_decompress_struct info;
+		ErrorManager error;
+		info.err = jpeg_std_error(&error.Manager);
+		error.Manager.error_exit = OnError;
+		error.Manager.output_message = OnMessage;
+		if (setjmp(error.Jump) != 0)
+		{
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		jpeg_create_decompress(&info);
+		jpeg_mem_src(&info, const_cast< uchar * >(data), static_cast< unsigned long >(size));
+		if (jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK)
+		{
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		// only handle the usual color spaces, let Qt handle the rest
+		QImage::Format format;
+		if (info.num_components == 1)
+		{
+			info.out_color_space = JCS_GRAYSCALE;
+			format = QImage::Format_Grayscale8;
+		}
+		else if (info.jpeg_color_space == JCS_YCbCr || info.jpeg_color_space == JCS_RGB)
+		{
+			info.out_color_space = JCS_RGB;
+			format = QImage::Format_RGB888;
+		}
+		else
+		{
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		// use the largest downscale keeping the image larger than the target
+		info.scale_num = 1;
+		info.scale_denom = 1;
+		for (unsigned int denom = 8; denom > 1; denom /= 2)
+		{
+			if ((info.image_width + denom - 1) / denom >= static_cast< unsigned int >(target.width()) &&
+				(info.image_height + denom - 1) / denom >= static_cast< unsigned int >(target.height()))
+			{
+				info.scale_denom = denom;
+				break;
+			}
+		}
+
+		// the image is scaled again after, so don't waste time on quality here
+		if (info.scale_denom > 1)
+		{
+			info.do_fancy_upsampling = FALSE;
+		}
+
+		jpeg_start_decompress(&info);
+		image = QImage(static_cast< int >(info.output_width), static_cast< int >(info.output_height), format);
+		if (image.isNull() == true)
+		{
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+		while (info.output_scanline < info.output_height)
+		{
+			JSAMPROW row = image.scanLine(static_cast< int >(info.output_scanline));
+			jpeg_read_scanlines(&info, &row, 1);
+		}
+		jpeg_finish_decompress(&info);
+		jpeg_destroy_decompress(&info);
+		return true;
+	}
+
+	//!
+	//! Decode a JPEG file at a reduced size
+	//!
+	QImage DecodeJpeg(const QString & path, const QSize & size)
+	{
+		QFile file(path);
+		if (file.open(QIODevice::ReadOnly) == false || file.size() == 0)
+		{
+			return QImage();
+		}
+		const uchar * data = file.map(0, file.size());
+		if (data == nullptr)
+		{
+			return QImage();
+		}
+
+		QImage image;
+		if (Decode(data, file.size(), size, image) == false)
+		{
+			return QImage();
+		}
+		file.unmap(const_cast< uchar * >(data));
+
+		// final high quality scaling
+		if (size.isValid() == true && image.size() != size)
+		{
+			image = Downscale(image, size);
+		}
+		return image;
+	}
+
+#else
+
+	//!
+	//! Built without libjpeg, let the caller use Qt
+	//!
+	QImage DecodeJpeg(const QString & path, const QSize & size)
+	{
+		Q_UNUSED(path);
+		Q_UNUSED(size);
+		return QImage();
+	}
+
+#endif
+
+} // namespace MediaViewer
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Decode a JPEG file directly at a reduced size.
+	//!
+	//! libjpeg can scale the image while decoding it (in the DCT domain) by 1/2, 1/4 or 1/8, which
+	//! skips most of the decoding work. The largest factor which keeps the image at least as large
+	//! as the requested size is used, and the result is then downscaled to the requested size.
+	//!
+	//! @param path
+	//!		The JPEG file.
+	//!
+	//! @param size
+	//!		The size of the decoded image.
+	//!
+	//! @return
+	//!		The decoded image, without any EXIF orientation applied. A null image if the file couldn't
+	//!		be decoded, or if the application was built without libjpeg.
+	//!
+	QImage DecodeJpeg(const QString & path, const QSize & size);
+
+} // namespace MediaViewer
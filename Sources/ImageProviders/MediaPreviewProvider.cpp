@@ -1,31 +1,48 @@
 #include "MediaPreviewProvider.h"
 
-#include "CppUtils/Hash.h"
 #include "CppUtils/MemoryTracker.h"
+#include "Downscale.h"
+#include "EmbeddedPreview.h"
 #include "ImageResponse.h"
+#include "JpegDecoder.h"
+#include "MovieDecoder.h"
 #include "QtUtils/Settings.h"
-#include "Utils/Job.h"
 
+#include <QBuffer>
 #include <QDir>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QImageReader>
-#include <QMediaPlayer>
+#include <QMutexLocker>
 #include <QRegularExpression>
 #include <QStandardPaths>
 
 namespace MediaViewer
 {
 
+	//! Maximum number of milliseconds spent on a single movie
+	static constexpr int MovieTimeout = 5000;
+
+	//! Maximum number of milliseconds spent on the strip of a single movie
+	static constexpr int StripTimeout = 15000;
+
+	//! Maximum number of frames in a movie strip
+	static constexpr int MaxStripFrames = 64;
+
 	//!
 	//! Constructor
 	//!
 	MediaPreviewProvider::MediaPreviewProvider(void)
 		: m_UseCache(Settings::Get< bool >("MediaPreviewProvider.UseCache"))
 		, m_CachePath(Settings::Get< QString >("MediaPreviewProvider.CachePath"))
-		, m_CancelTime(QTime::currentTime())
+		, m_MoviePosition(Settings::Get< int >("MediaPreviewProvider.MoviePosition"))
+		, m_MovieCandidates(Settings::Get< int >("MediaPreviewProvider.MovieCandidates"))
+		, m_Generation(0)
 	{
-		QDir().mkpath(m_CachePath);
+		m_Cache.SetBudget(static_cast< uint64_t >(Settings::Get< int >("MediaPreviewProvider.CacheSize")) * 1024 * 1024);
+		m_Cache.Open(m_CachePath);
+		m_Images.SetBudget(static_cast< uint64_t >(Settings::Get< int >("MediaPreviewProvider.MemoryCacheSize")) * 1024 * 1024);
+
+		// keep the threads alive, since each of them owns a movie decoder which is expensive to create
+		m_Pool.setExpiryTimeout(-1);
 	}
 
 	//!
@@ -37,6 +54,13 @@ namespace MediaViewer
 		this->cancelPending();
 		m_Pool.clear();
 		m_Pool.waitForDone();
+
+		// responses still owned by the engine must not call us back
+		QMutexLocker lock(&m_ResponsesMutex);
+		for (ImageResponse * response : qAsConst(m_Responses))
+		{
+			response->SetDestroyedCallback(nullptr);
+		}
 	}
 
 	//!
@@ -48,7 +72,9 @@ namespace MediaViewer
 	}
 
 	//!
-	//! Get an image for the given id
+	//! Get an image for the given id. The id is the path of the media, optionally followed by the
+	//! size of the preview (`path?width&height`) and by a number of frames (`&frames=N`) to get
+	//! a strip of N frames of a movie, laid out left to right.
 	//!
 	QQuickImageResponse * MediaPreviewProvider::requestImageResponse(const QString & id, const QSize & requestedSize)
 	{
@@ -57,9 +83,10 @@ namespace MediaViewer
 		int height = requestedSize.height() > 0 ? requestedSize.height() : -1;
 
 		// parse the id
-		QRegularExpression address("(?<path>[^?]*)(\\?(?<width>\\d+)&(?<height>\\d+))?");
+		QRegularExpression address("(?<path>[^?]*)(\\?(?<width>\\d+)&(?<height>\\d+))?([?&]frames=(?<frames>\\d+))?");
 		QRegularExpressionMatch match = address.match(id);
 		QString path;
+		int frames = 0;
 		if (match.hasMatch() == true)
 		{
 			path = match.captured("path");
@@ -73,59 +100,61 @@ namespace MediaViewer
 			{
 				height = h.toInt();
 			}
+			frames = qBound(0, match.captured("frames").toInt(), MaxStripFrames);
+		}
+
+		// get the key of this thumbnail
+		const uint64_t key = ThumbnailCache::GetKey(path, width, height, frames);
+
+		// if it was recently used and the media didn't change, it's still in memory
+		ThumbnailCache::Source current;
+		QImage cached;
+		if (ThumbnailCache::GetSource(path, current) == true && m_Images.Get(key, current, cached) == true)
+		{
+			return MT_NEW MediaViewer::ImageResponse(cached);
 		}
 
 		// create the image response
-		return MT_NEW MediaViewer::ImageResponse([=] (std::atomic_bool & cancel) -> QImage {
+		QMutexLocker lock(&m_ResponsesMutex);
+		const uint64_t generation = m_Generation;
+		ImageResponse * response = MT_NEW MediaViewer::ImageResponse([=] (std::atomic_bool & cancel) -> QImage {
 
 			// avoid wasting time
-			if (QTime::currentTime() < m_CancelTime)
+			if (generation != m_Generation)
 			{
 				return QImage();
 			}
 
-			// ensure the image exists
-			if (QFile::exists(path) == false)
+			// ensure the image exists, and get its current state
+			ThumbnailCache::Source source;
+			if (ThumbnailCache::GetSource(path, source) == false)
 			{
 				return QImage();
 			}
 
-			// get the hash corresponding to this thumbnail
-			uint32_t hash = Hash::Combine(
-				Hash::Jenkins(path.toLocal8Bit().data(), size_t(path.size())),
-				static_cast< unsigned int >(width),
-				static_cast< unsigned int >(height)
-			);
-
-			// get the source file info and a few information
-			const QFileInfo source(path);
-			const QString extension(source.suffix());
-			const QString cacheFolder	= this->GetCacheFolder(hash);
-			const QString cacheName		= QString("%1/%2").arg(cacheFolder).arg(static_cast< qulonglong >(hash));
-			const QString descName		= QString("%1.json").arg(cacheName);
-			const QString thumbnail		= QString("%1.jpg").arg(cacheName);
-
 			// check if we have a thumbnail already
-			QFile descFile(descName);
-			if (m_UseCache == true && descFile.open(QIODevice::ReadOnly) == true)
+			QByteArray data;
+			if (m_UseCache == true && m_Cache.Get(key, source, data) == true)
 			{
-				const QJsonDocument desc(QJsonDocument::fromJson(descFile.readAll()));
-				const QJsonObject root = desc.object();
-				if (source.size() == root["size"].toInt() &&
-					source.lastModified().toString() == root["date"].toString() &&
-					QFile::exists(root["thumbnail"].toString()))
+				QImage image;
+				if (image.loadFromData(data, "JPG") == true)
 				{
-					return QImage(root["thumbnail"].toString());
+					m_Images.Put(key, source, image);
+					return image;
 				}
 			}
 
 			// the image is no in the cache, load it
 			QImage image;
-			if (cancel == false && image.isNull() == true)
+			if (cancel == false && frames > 0)
+			{
+				image = this->GetMovieStrip(path, width, height, frames, cancel);
+			}
+			if (cancel == false && image.isNull() == true && frames == 0)
 			{
 				image = this->GetImagePreview(path, width, height, cancel);
 			}
-			if (cancel == false && image.isNull() == true)
+			if (cancel == false && image.isNull() == true && frames == 0)
 			{
 				image = this->GetMoviePreview(path, width, height, cancel);
 			}
@@ -139,49 +168,44 @@ namespace MediaViewer
 			// update cache if needed
 			if (cancel == false && m_UseCache == true)
 			{
-				// ensure the folder exists
-				QDir().mkpath(cacheFolder);
-
-				// save the image
-				if (image.save(thumbnail) == true)
+				data.clear();
+				QBuffer buffer(&data);
+				if (buffer.open(QIODevice::WriteOnly) == false || image.save(&buffer, "JPG") == false)
 				{
-					// write description
-					QJsonObject root;
-					root["size"] = source.size();
-					root["date"] = source.lastModified().toString();
-					root["thumbnail"] = thumbnail;
-					QFile desc(descName);
-					if (desc.open(QIODevice::WriteOnly) == true)
-					{
-						desc.write(QJsonDocument(root).toJson());
-					}
-					else
-					{
-						qDebug() << "failed writing preview metadata " << descName << " to disk";
-					}
+					qDebug() << "failed encoding image preview for " << path;
 				}
-				else
+				else if (m_Cache.Put(key, source, image.size(), data) == false)
 				{
-					qDebug() << "failed writing image preview " << thumbnail << " to disk";
+					qDebug() << "failed writing image preview for " << path << " to the cache";
 				}
 			}
 
+			// keep it in memory for the next requests
+			if (cancel == false)
+			{
+				m_Images.Put(key, source, image);
+			}
+
 			// return the image
 			return image;
 
-		}, &m_Pool);
+		}, &m_Pool, this->GetPriority(path));
+
+		// track it until it's destroyed, to be able to update its priority
+		m_Responses.insert(path, response);
+		response->SetDestroyedCallback([this, path] (ImageResponse * destroyed) {
+			QMutexLocker lock(&m_ResponsesMutex);
+			m_Responses.remove(path, destroyed);
+		});
+		return response;
 	}
 
 	//!
-	//! Compute a cache folder for a given hash
+	//! Get the scheduling priority of a media. The responses mutex must be locked.
 	//!
-	QString MediaPreviewProvider::GetCacheFolder(uint32_t hash) const
+	int MediaPreviewProvider::GetPriority(const QString & path) const
 	{
-		QString hashName = QString("%1").arg(static_cast< uint >(hash), 8, 10, static_cast< QChar >('0'));
-		Q_ASSERT(hashName.size() >= 8);
-		return QString("%1/%2%3%4%5/%6%7%8%9").arg(m_CachePath)
-			.arg(hashName[0]).arg(hashName[1]).arg(hashName[2]).arg(hashName[3])
-			.arg(hashName[4]).arg(hashName[5]).arg(hashName[6]).arg(hashName[7]);
+		return m_Priorities.value(path, Priority::Background);
 	}
 
 	//!
@@ -207,19 +231,55 @@ namespace MediaViewer
 			{
 				if (width < imageSize.width() || height < imageSize.height())
 				{
+					QSize scaledSize;
 					if (imageSize.width() > imageSize.height())
 					{
-						imageReader.setScaledSize({
+						scaledSize = {
 							width,
 							int(width * (imageSize.height() / double(imageSize.width())))
-						});
+						};
 					}
 					else
 					{
-						imageReader.setScaledSize({
+						scaledSize = {
 							int(height * (imageSize.width() / double(imageSize.height()))),
 							height
-						});
+						};
+					}
+
+					// the embedded preview is much faster to load, use it if it's large enough
+					QImage preview = this->GetEmbeddedPreview(path, imageSize, scaledSize);
+					if (preview.isNull() == false)
+					{
+						return preview;
+					}
+
+					// JPEG images can be decoded directly at a fraction of their size
+					if (cancel == false && imageReader.format() == "jpeg")
+					{
+						QImage image = DecodeJpeg(path, scaledSize);
+						if (image.isNull() == false)
+						{
+							return ApplyOrientation(image, GetExifOrientation(path));
+						}
+					}
+
+					// only let the reader scale if it can do it while decoding, otherwise it decodes
+					// the full image and uses QImage::scaled, which is a lot slower than our downscaler
+					if (imageReader.supportsOption(QImageIOHandler::ScaledSize) == true)
+					{
+						imageReader.setScaledSize(scaledSize);
+					}
+					else
+					{
+						const QImage image = cancel == false ? imageReader.read() : QImage();
+						if (cancel == true || image.isNull() == true)
+						{
+							return QImage();
+						}
+
+						// the image might have been rotated by the reader
+						return Downscale(image, image.size() == imageSize ? scaledSize : scaledSize.transposed());
 					}
 				}
 			}
@@ -230,71 +290,93 @@ namespace MediaViewer
 	}
 
 	//!
-	//! Try to get a preview for a movie
+	//! Try to get a preview from the thumbnail embedded in an image.
 	//!
-	QImage MediaPreviewProvider::GetMoviePreview(const QString & path, int width, int height, std::atomic_bool & cancel)
+	//! @param path
+	//!		The image.
+	//!
+	//! @param imageSize
+	//!		Size of the full image, before any EXIF transformation.
+	//!
+	//! @param scaledSize
+	//!		Size of the requested preview, before any EXIF transformation.
+	//!
+	//! @return
+	//!		The transformed preview, or a null image if the image doesn't contain a thumbnail, or if it's
+	//!		too small or doesn't have the same aspect ratio as the image (some cameras add black bars)
+	//!
+	QImage MediaPreviewProvider::GetEmbeddedPreview(const QString & path, const QSize & imageSize, const QSize & scaledSize)
 	{
-		// create stuff needed for the video capture
-		QEventLoop loop;
-		QMediaPlayer * player = MT_NEW QMediaPlayer();
-		VideoCapture * output = MT_NEW VideoCapture(path, loop, cancel);
-
-		// check for invalid media errors
-		QObject::connect(player, &QMediaPlayer::mediaStatusChanged, [&] (QMediaPlayer::MediaStatus status) {
-			if (status == QMediaPlayer::InvalidMedia)
-			{
-				qDebug("%s invalid media", qPrintable(path));
-				loop.quit();
-			}
-		});
-
-		// on error, just stop the loop
-		QObject::connect(player, static_cast< void (QMediaPlayer::*)(QMediaPlayer::Error) >(&QMediaPlayer::error), [&] (QMediaPlayer::Error error) {
-			qDebug() << "failed generating preview for " << path << " with error " <<  error;
-			loop.quit();
-		});
+		QByteArray data;
+		int orientation = 1;
+		if (MediaViewer::GetEmbeddedPreview(path, data, orientation) == false)
+		{
+			return QImage();
+		}
 
-		// when the position changes, enabled capture and start playing
-		bool first = true;
-		QObject::connect(player, &QMediaPlayer::positionChanged, [&] (qint64 position) {
-			Q_UNUSED(position);
-			if (cancel == true)
-			{
-				loop.quit();
-			}
-			if (first == true)
-			{
-				output->Capture(10);
-				player->play();
-				first = false;
-			}
-		});
+		// check the size without decoding
+		QBuffer buffer(&data);
+		QImageReader reader(&buffer, "JPG");
+		reader.setAutoTransform(false);
+		const QSize size = reader.size();
+		if (size.width() < scaledSize.width() || size.height() < scaledSize.height())
+		{
+			return QImage();
+		}
+		const double imageRatio = imageSize.width() / double(imageSize.height());
+		const double ratio = size.width() / double(size.height());
+		if (qAbs(ratio - imageRatio) > 0.02 * imageRatio)
+		{
+			return QImage();
+		}
 
-		// setup the player
-		if (cancel == false)
+		// decode it
+		if (size != scaledSize)
+		{
+			reader.setScaledSize(scaledSize);
+		}
+		QImage image = reader.read();
+		if (image.isNull() == true)
 		{
-			player->setVideoOutput(output);
-			player->setMuted(true);
-			player->setMedia(QUrl::fromLocalFile(path));
+			return image;
 		}
 
-		// wait for the capture
-		loop.exec();
+		// and apply the orientation of the image
+		return ApplyOrientation(image, orientation);
+	}
 
-		// cleanup
-		player->stop();
+	//!
+	//! Try to get a preview for a movie
+	//!
+	QImage MediaPreviewProvider::GetMoviePreview(const QString & path, int width, int height, std::atomic_bool & cancel)
+	{
+		// decode a frame with the decoder of this thread. It's downscaled while being captured
+		bool timedOut = false;
+		const QSize size = width != -1 && height != -1 ? QSize(width, height) : QSize();
+		const QImage frame = MovieDecoder::GetThreadDecoder().Decode(path, cancel, MovieTimeout, m_MoviePosition / 100.0, m_MovieCandidates, size, timedOut);
 
-		// get the captured frame
-		QImage result = cancel == false && output->GetFrame().isNull() == false ?
-			output->GetFrame().scaled({ width, height }, Qt::AspectRatioMode::KeepAspectRatio, Qt::TransformationMode::SmoothTransformation) :
-			output->GetFrame();
+		// the backend might be stuck, start from a fresh decoder next time
+		if (timedOut == true)
+		{
+			MovieDecoder::ReleaseThreadDecoder();
+		}
 
-		// cleanup
-		MT_DELETE player;
-		MT_DELETE output;
+		return cancel == false ? frame : QImage();
+	}
 
-		// done
-		return result;
+	//!
+	//! Get a strip of evenly spaced frames of a movie, each of them fitting in the given size
+	//!
+	QImage MediaPreviewProvider::GetMovieStrip(const QString & path, int width, int height, int frames, std::atomic_bool & cancel)
+	{
+		bool timedOut = false;
+		const QSize size = width != -1 && height != -1 ? QSize(width, height) : QSize();
+		const QImage strip = MovieDecoder::GetThreadDecoder().DecodeStrip(path, cancel, StripTimeout, frames, size, timedOut);
+		if (timedOut == true)
+		{
+			MovieDecoder::ReleaseThreadDecoder();
+		}
+		return cancel == false ? strip : QImage();
 	}
 
 	//!
@@ -345,6 +427,9 @@ namespace MediaViewer
 		// if different, update
 		if (newPath != m_CachePath)
 		{
+			// release the store's files
+			m_Cache.Close();
+
 			// ensure the new path doesn't exist
 			QDir(newPath).removeRecursively();
 
@@ -362,215 +447,188 @@ namespace MediaViewer
 				QDir().mkdir(newPath);
 			}
 
-			// update the path and notify
+			// update the path, reopen the store and notify
 			m_CachePath = newPath;
+			m_Cache.Open(m_CachePath);
 			Settings::Set("MediaPreviewProvider.CachePath", m_CachePath);
 			emit cachePathChanged(m_CachePath);
 		}
 	}
 
 	//!
-	//! Remove the thumbnail cache folder
+	//! Get the maximum size of the cache, in megabytes. 0 means no limit.
+	//!
+	int MediaPreviewProvider::GetCacheSize(void) const
+	{
+		return static_cast< int >(m_Cache.GetBudget() / (1024 * 1024));
+	}
+
+	//!
+	//! Set the maximum size of the cache, in megabytes. 0 means no limit. When the cache grows past
+	//! this size, the least recently used thumbnails are removed.
 	//!
-	void MediaPreviewProvider::clearCache(void) const
+	void MediaPreviewProvider::SetCacheSize(int size)
 	{
-		if (QDir(m_CachePath).removeRecursively() == true)
+		size = qMax(size, 0);
+		if (size != this->GetCacheSize())
 		{
-			QDir().mkdir(m_CachePath);
+			m_Cache.SetBudget(static_cast< uint64_t >(size) * 1024 * 1024);
+			Settings::Set("MediaPreviewProvider.CacheSize", size);
+			emit cacheSizeChanged(size);
 		}
 	}
 
 	//!
-	//! Call this when you know all the preview are going to be re-created (typically when changing the thumbnail size)
+	//! Get the maximum size of the decoded thumbnails kept in memory, in megabytes.
 	//!
-	void MediaPreviewProvider::cancelPending(void)
+	int MediaPreviewProvider::GetMemoryCacheSize(void) const
 	{
-		m_CancelTime = QTime::currentTime();
+		return static_cast< int >(m_Images.GetBudget() / (1024 * 1024));
 	}
 
+	//!
+	//! Set the maximum size of the decoded thumbnails kept in memory, in megabytes. 0 disables it.
+	//!
+	void MediaPreviewProvider::SetMemoryCacheSize(int size)
+	{
+		size = qMax(size, 0);
+		if (size != this->GetMemoryCacheSize())
+		{
+			m_Images.SetBudget(static_cast< uint64_t >(size) * 1024 * 1024);
+			Settings::Set("MediaPreviewProvider.MemoryCacheSize", size);
+			emit memoryCacheSizeChanged(size);
+		}
+	}
 
 	//!
-	//! Constructor
+	//! Get where movie previews are taken, in percents of the duration of the movies.
 	//!
-	VideoCapture::VideoCapture(const QString & path, QEventLoop & loop, std::atomic_bool & cancel)
-		: m_Path(path)
-		, m_Loop(loop)
-		, m_Cancel(cancel)
-		, m_Capture(false)
-		, m_Retries(0)
+	int MediaPreviewProvider::GetMoviePosition(void) const
 	{
+		return m_MoviePosition;
 	}
 
 	//!
-	//! Enable capture for the next presented frame
+	//! Set where movie previews are taken, in percents of the duration of the movies. Taking them
+	//! a bit after the start avoids black intro frames. Only affects new previews.
 	//!
-	void VideoCapture::Capture(int retries)
+	void MediaPreviewProvider::SetMoviePosition(int position)
 	{
-		m_Capture = true;
-		m_Retries = retries;
+		position = qBound(0, position, 100);
+		if (position != m_MoviePosition)
+		{
+			m_MoviePosition = position;
+			Settings::Set("MediaPreviewProvider.MoviePosition", position);
+			emit moviePositionChanged(position);
+		}
 	}
 
 	//!
-	//! Get the captured frame
+	//! Get the number of frames among which movie previews are chosen.
 	//!
-	const QImage & VideoCapture::GetFrame(void) const
+	int MediaPreviewProvider::GetMovieCandidates(void) const
 	{
-		return m_Frame;
+		return m_MovieCandidates;
 	}
 
 	//!
-	//! Reimplemented from QAbstractVideoSurface. This is called whenever a new frame is available.
+	//! Set the number of frames among which movie previews are chosen. When greater than 1, that
+	//! many frames are decoded and the most detailed one is used. Only affects new previews.
 	//!
-	bool VideoCapture::present(const QVideoFrame & source)
+	void MediaPreviewProvider::SetMovieCandidates(int candidates)
 	{
-		if (m_Capture == false)
+		candidates = qBound(1, candidates, 16);
+		if (candidates != m_MovieCandidates)
 		{
-			return true;
+			m_MovieCandidates = candidates;
+			Settings::Set("MediaPreviewProvider.MovieCandidates", candidates);
+			emit movieCandidatesChanged(candidates);
 		}
+	}
 
-		// avoid re-capturing
-		if (m_Retries.fetch_sub(1) <= 0)
-		{
-			m_Capture = false;
-		}
+	//!
+	//! Set the maximum number of previews generated concurrently. Defaults to the number of cores.
+	//!
+	void MediaPreviewProvider::SetThreadCount(int count)
+	{
+		m_Pool.setMaxThreadCount(qMax(count, 1));
+	}
 
-		// check the frame
-		if (source.isValid() == false)
-		{
-			qDebug() << m_Path << " - invalid frame - " << this->error();
-			if (m_Capture == false)
-			{
-				m_Loop.quit();
-			}
-			return false;
-		}
+	//!
+	//! Remove every thumbnail from the cache
+	//!
+	void MediaPreviewProvider::clearCache(void)
+	{
+		m_Images.Clear();
+		m_Cache.Clear();
+	}
 
-		// check cancellation
-		if (m_Cancel == true)
+	//!
+	//! Call this when you know all the preview are going to be re-created (typically when changing the thumbnail size)
+	//!
+	//! Queued responses are removed from the pool and finished right away, and the running ones are
+	//! notified through their cancel flag.
+	//!
+	void MediaPreviewProvider::cancelPending(void)
+	{
+		QMutexLocker lock(&m_ResponsesMutex);
+		++m_Generation;
+		for (ImageResponse * response : qAsConst(m_Responses))
 		{
-			m_Loop.quit();
-			return false;
+			response->cancel();
 		}
+	}
 
-		// map our frame (we need to make a local copy since we receive the frame as an immutable reference)
-		QVideoFrame frame(source);
-		if (frame.map(QAbstractVideoBuffer::MapMode::ReadOnly) == false)
-		{
-			qDebug() << m_Path << " - failed mapping frame - " << this->error();
-			if (m_Capture == false)
-			{
-				m_Loop.quit();
-			}
-			return false;
-		}
+	//!
+	//! Update the priorities of the previews. Previews of the visible medias are generated first,
+	//! then the ones in the prefetch margin, then everything else. Previews which are already being
+	//! generated are not affected.
+	//!
+	//! @param visible
+	//!		Paths of the visible medias.
+	//!
+	//! @param prefetch
+	//!		Paths of the medias which are likely to become visible soon.
+	//!
+	void MediaPreviewProvider::setViewport(const QStringList & visible, const QStringList & prefetch)
+	{
+		QMutexLocker lock(&m_ResponsesMutex);
 
-		// check cancellation
-		if (m_Cancel == true)
+		// update the priorities
+		QHash< QString, int > previous;
+		previous.swap(m_Priorities);
+		m_Priorities.reserve(visible.size() + prefetch.size());
+		for (const QString & path : prefetch)
 		{
-			frame.unmap();
-			m_Loop.quit();
-			return false;
+			m_Priorities.insert(path, Priority::Prefetch);
 		}
-
-		if (source.pixelFormat() != QVideoFrame::Format_Invalid)
+		for (const QString & path : visible)
 		{
-			// setup the image
-			QImage capturedFrame(frame.width(), frame.height(), QVideoFrame::imageFormatFromPixelFormat(frame.pixelFormat()));
-
-			// check the size of the source frame and destination capture
-			const int srcBytes = frame.mappedBytes();
-			const qsizetype dstBytes = capturedFrame.sizeInBytes();
-
-			// check cancellation
-			if (m_Cancel == true)
-			{
-				frame.unmap();
-				m_Loop.quit();
-				return false;
-			}
+			m_Priorities.insert(path, Priority::Visible);
+		}
 
-			// depending on those sizes, extracting the frame is done differently
-			if (dstBytes == srcBytes)
-			{
-				// simple case, the image can be copied in one go
-				memcpy(capturedFrame.bits(), frame.bits(), srcBytes);
-			}
-			else if (dstBytes < srcBytes)
+		// re-queue the pending responses whose priority changed
+		auto update = [&] (const QString & path) {
+			const int priority = this->GetPriority(path);
+			if (priority != previous.value(path, Priority::Background))
 			{
-				// more complex case, it seems in some cases there is some padding at the end of each
-				// lines, so we need to copy them one at a time
-				uchar * src = frame.bits();
-				uchar * dst = capturedFrame.bits();
-				const int srcBytesPerLine = frame.bytesPerLine();
-				const int dstBytesPerLine = static_cast< int >(dstBytes / capturedFrame.height());
-				for (int i = 0, iend = frame.height(); i < iend; ++i)
+				for (auto it = m_Responses.find(path); it != m_Responses.end() && it.key() == path; ++it)
 				{
-
-					// check cancellation
-					if (m_Cancel == true)
-					{
-						frame.unmap();
-						m_Loop.quit();
-						return false;
-					}
-
-					memcpy(dst, src, dstBytesPerLine);
-					src += srcBytesPerLine;
-					dst += dstBytesPerLine;
+					it.value()->SetPriority(priority);
 				}
 			}
-			else
-			{
-				// ok here I don't know what the hell's going on
-				Q_ASSERT(false && "incompatible sizes");
-			}
-
-			// store the captured frame
-			m_Frame = capturedFrame;
+		};
+		for (auto it = m_Priorities.cbegin(); it != m_Priorities.cend(); ++it)
+		{
+			update(it.key());
 		}
-		else
+		for (auto it = previous.cbegin(); it != previous.cend(); ++it)
 		{
-			qDebug() << m_Path << " - invalid format - " << source.pixelFormat();
-			if (m_Capture == false)
+			if (m_Priorities.contains(it.key()) == false)
 			{
-				m_Loop.quit();
+				update(it.key());
 			}
-			return false;
 		}
-
-		// release the frame
-		frame.unmap();
-
-		// stop the loop
-		m_Loop.quit();
-
-		// and done !
-		return true;
-	}
-
-	//!
-	//! Reimplemented from QAbstractVideoSurface.
-	//!
-	QList< QVideoFrame::PixelFormat > VideoCapture::supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const
-	{
-		Q_UNUSED(type);
-		return {
-			QVideoFrame::Format_RGB24,
-			QVideoFrame::Format_RGB32,
-			QVideoFrame::Format_RGB555,
-			QVideoFrame::Format_RGB565,
-			QVideoFrame::Format_BGR24,
-			QVideoFrame::Format_BGR32,
-			QVideoFrame::Format_BGR555,
-			QVideoFrame::Format_BGR565,
-			QVideoFrame::Format_BGRA32,
-			QVideoFrame::Format_BGRA32_Premultiplied,
-			QVideoFrame::Format_BGRA5658_Premultiplied,
-			QVideoFrame::Format_ARGB32,
-			QVideoFrame::Format_ARGB32_Premultiplied,
-			QVideoFrame::Format_ARGB8565_Premultiplied,
-			QVideoFrame::Format_Jpeg
-		};
 	}
 
 }
@@ -1,16 +1,23 @@
 #pragma once
 
-#include <QAbstractVideoSurface>
-#include <QEventLoop>
+#include "ImageCache.h"
+#include "ThumbnailCache.h"
+
+#include <QMultiHash>
+#include <QMutex>
 #include <QObject>
 #include <QQuickAsyncImageProvider>
 #include <QThreadPool>
-#include <QTime>
+
+#include <atomic>
 
 
 namespace MediaViewer
 {
 
+	class ImageResponse;
+
+
 	//!
 	//! Custom image provider used to generate previews of images, optionally handling caching
 	//!
@@ -23,14 +30,30 @@ namespace MediaViewer
 
 		Q_PROPERTY(bool useCache READ GetUseCache WRITE SetUseCache NOTIFY useCacheChanged)
 		Q_PROPERTY(QString cachePath READ GetCachePath WRITE SetCachePath NOTIFY cachePathChanged)
+		Q_PROPERTY(int cacheSize READ GetCacheSize WRITE SetCacheSize NOTIFY cacheSizeChanged)
+		Q_PROPERTY(int memoryCacheSize READ GetMemoryCacheSize WRITE SetMemoryCacheSize NOTIFY memoryCacheSizeChanged)
+		Q_PROPERTY(int moviePosition READ GetMoviePosition WRITE SetMoviePosition NOTIFY moviePositionChanged)
+		Q_PROPERTY(int movieCandidates READ GetMovieCandidates WRITE SetMovieCandidates NOTIFY movieCandidatesChanged)
 
 	signals:
 
 		void	useCacheChanged(bool useCache);
 		void	cachePathChanged(QString cachePath);
+		void	cacheSizeChanged(int cacheSize);
+		void	memoryCacheSizeChanged(int memoryCacheSize);
+		void	moviePositionChanged(int moviePosition);
+		void	movieCandidatesChanged(int movieCandidates);
 
 	public:
 
+		//! Scheduling priorities of the previews. Higher priorities are generated first.
+		enum Priority
+		{
+			Background = 0,
+			Prefetch,
+			Visible
+		};
+
 		MediaPreviewProvider(void);
 		~MediaPreviewProvider(void);
 
@@ -43,17 +66,29 @@ namespace MediaViewer
 		void				SetUseCache(bool value);
 		const QString &		GetCachePath(void) const;
 		void				SetCachePath(const QString & path);
+		int					GetCacheSize(void) const;
+		void				SetCacheSize(int size);
+		int					GetMemoryCacheSize(void) const;
+		void				SetMemoryCacheSize(int size);
+		int					GetMoviePosition(void) const;
+		void				SetMoviePosition(int position);
+		int					GetMovieCandidates(void) const;
+		void				SetMovieCandidates(int candidates);
+		void				SetThreadCount(int count);
 
 		// public QML API
-		Q_INVOKABLE void	clearCache(void) const;
+		Q_INVOKABLE void	clearCache(void);
 		Q_INVOKABLE void	cancelPending(void);
+		Q_INVOKABLE void	setViewport(const QStringList & visible, const QStringList & prefetch);
 
 	private:
 
 		// private API
-		QString	GetCacheFolder(uint32_t hash) const;
 		QImage	GetImagePreview(const QString & path, int width, int height, std::atomic_bool & cancel);
+		QImage	GetEmbeddedPreview(const QString & path, const QSize & imageSize, const QSize & scaledSize);
 		QImage	GetMoviePreview(const QString & path, int width, int height, std::atomic_bool & cancel);
+		QImage	GetMovieStrip(const QString & path, int width, int height, int frames, std::atomic_bool & cancel);
+		int		GetPriority(const QString & path) const;
 
 		//! true if we should cache the thumbnails, false otherwise
 		bool m_UseCache;
@@ -61,59 +96,34 @@ namespace MediaViewer
 		//! path to the thumbnail cache
 		QString m_CachePath;
 
-		//! pool used to handle the image responses
-		QThreadPool m_Pool;
-
-		//! time of the last call to cancelPending
-		QTime m_CancelTime;
-
-
-	};
-
+		//! where movie previews are taken, in percents of the duration
+		std::atomic_int m_MoviePosition;
 
-	//!
-	//! Utility class used with a QMediaPlayer to capture a frame of a movie.
-	//!
-	class VideoCapture
-		: public QAbstractVideoSurface
-	{
-
-	public:
-
-		// Constructor
-		VideoCapture(const QString & path, QEventLoop & loop, std::atomic_bool & cancel);
+		//! number of frames among which movie previews are chosen
+		std::atomic_int m_MovieCandidates;
 
-		// API
-		void			Capture(int retries);
-		const QImage &	GetFrame(void) const;
+		//! the thumbnail store
+		ThumbnailCache m_Cache;
 
-	protected:
+		//! the decoded thumbnails which were recently used
+		ImageCache m_Images;
 
-		// Reimplemented from QAbstractVideoSurface
-		bool								present(const QVideoFrame & source) override;
-		QList< QVideoFrame::PixelFormat >	supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const override;
-
-	private:
-
-		//! The movie path (for debugging only)
-		QString m_Path;
+		//! pool used to handle the image responses
+		QThreadPool m_Pool;
 
-		//! Used to stop the capture in case of errors
-		QEventLoop & m_Loop;
+		//! the responses which were not destroyed yet, by media path
+		QMultiHash< QString, ImageResponse * > m_Responses;
 
-		//! Used to cancel the capture
-		std::atomic_bool & m_Cancel;
+		//! priorities of the medias in and around the viewport
+		QHash< QString, int > m_Priorities;
 
-		//! When true, the next presented frame will be captured
-		std::atomic_bool m_Capture;
+		//! protects the responses and the priorities
+		mutable QMutex m_ResponsesMutex;
 
-		//! Number of times to retry capturing
-		std::atomic_int m_Retries;
+		//! incremented by cancelPending, responses created before the last increment are stale
+		std::atomic< uint64_t > m_Generation;
 
-		//! The captured frame
-		QImage m_Frame;
 
 	};
 
-
 }
@@ -0,0 +1,619 @@
+#include "MovieDecoder.h"
+
+#include "CppUtils/MemoryTracker.h"
+#include "Downscale.h"
+
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QMediaPlayer>
+#include <QThreadStorage>
+#include <QTimer>
+
+#include <cmath>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Get the entropy of the luma histogram of a frame. Uniform frames (black intros, fades, etc.)
+	//! have a low entropy, detailed ones a high entropy.
+	//!
+	static double GetEntropy(const QImage & frame)
+	{
+		const QImage luma = Downscale(frame, frame.size().scaled(64, 64, Qt::KeepAspectRatio)).convertToFormat(QImage::Format_Grayscale8);
+		if (luma.isNull() == true)
+		{
+			return 0.0;
+		}
+
+		int histogram[256] = { 0 };
+		for (int y = 0; y < luma.height(); ++y)
+		{
+			const uchar * line = luma.constScanLine(y);
+			for (int x = 0; x < luma.width(); ++x)
+			{
+				++histogram[line[x]];
+			}
+		}
+
+		const double count = luma.width() * luma.height();
+		double entropy = 0.0;
+		for (int value : histogram)
+		{
+			if (value != 0)
+			{
+				const double p = value / count;
+				entropy -= p * std::log2(p);
+			}
+		}
+		return entropy;
+	}
+
+	//!
+	//! Constructor
+	//!
+	MovieDecoder::MovieDecoder(void)
+		: m_Player(MT_NEW QMediaPlayer())
+		, m_Output(MT_NEW VideoCapture(m_Loop))
+		, m_Loaded(false)
+		, m_Failed(false)
+	{
+		m_Player->setVideoOutput(m_Output);
+		m_Player->setMuted(true);
+
+		// track the loading of the media
+		QObject::connect(m_Player, &QMediaPlayer::mediaStatusChanged, [this] (QMediaPlayer::MediaStatus status) {
+			if (m_Path.isEmpty() == true)
+			{
+				return;
+			}
+			if (status == QMediaPlayer::InvalidMedia)
+			{
+				qDebug("%s invalid media", qPrintable(m_Path));
+				m_Failed = true;
+				m_Loop.quit();
+			}
+			else if (status == QMediaPlayer::LoadedMedia && m_Loaded == false)
+			{
+				m_Loaded = true;
+				m_Loop.quit();
+			}
+		});
+
+		// on error, just stop the loop
+		QObject::connect(m_Player, static_cast< void (QMediaPlayer::*)(QMediaPlayer::Error) >(&QMediaPlayer::error), [this] (QMediaPlayer::Error error) {
+			if (m_Path.isEmpty() == false)
+			{
+				qDebug() << "failed generating preview for " << m_Path << " with error " <<  error;
+				m_Failed = true;
+				m_Loop.quit();
+			}
+		});
+	}
+
+	//!
+	//! Destructor
+	//!
+	MovieDecoder::~MovieDecoder(void)
+	{
+		MT_DELETE m_Player;
+		MT_DELETE m_Output;
+	}
+
+	//!
+	//! Decode a representative frame of a movie.
+	//!
+	//! @param path
+	//!		The movie.
+	//!
+	//! @param cancel
+	//!		Checked while decoding, decoding stops as soon as it's true.
+	//!
+	//! @param timeout
+	//!		Maximum number of milliseconds to spend on the movie.
+	//!
+	//! @param position
+	//!		Where to get the frame, as a fraction of the duration of the movie.
+	//!
+	//! @param candidates
+	//!		When greater than 1, that many frames are decoded, evenly spread between position and
+	//!		the end of the movie, and the most detailed one is returned.
+	//!
+	//! @param size
+	//!		The frame is downscaled to fit in this size. Use an invalid size to get the frame at full
+	//!		resolution.
+	//!
+	//! @param timedOut
+	//!		Set to true if the timeout was reached.
+	//!
+	//! @return
+	//!		The frame, or a null image on error, timeout or cancellation.
+	//!
+	QImage MovieDecoder::Decode(const QString & path, std::atomic_bool & cancel, int timeout, double position, int candidates, const QSize & size, bool & timedOut)
+	{
+		const QDeadlineTimer deadline(timeout);
+		if (this->Load(path, cancel, deadline, timedOut) == false)
+		{
+			this->Unload();
+			return QImage();
+		}
+
+		// seek and capture the candidates
+		QImage best;
+		double bestEntropy = -1.0;
+		const qint64 duration = m_Player->duration();
+		candidates = duration > 0 ? qMax(candidates, 1) : 1;
+		position = qBound(0.0, position, 1.0);
+		for (int i = 0; i < candidates && m_Failed == false && timedOut == false && cancel == false; ++i)
+		{
+			// keep the most detailed frame
+			const qint64 time = duration > 0 ? static_cast< qint64 >(duration * (position + i * (1.0 - position) / candidates)) : -1;
+			const QImage frame = this->Capture(time, size, cancel, deadline, timedOut);
+			if (frame.isNull() == false)
+			{
+				const double entropy = candidates > 1 ? GetEntropy(frame) : 0.0;
+				if (entropy > bestEntropy)
+				{
+					best = frame;
+					bestEntropy = entropy;
+				}
+			}
+		}
+
+		this->Unload();
+		if (timedOut == true)
+		{
+			qDebug() << "timeout while generating preview for " << path;
+		}
+		return cancel == false ? best : QImage();
+	}
+
+	//!
+	//! Decode evenly spaced frames of a movie into a sprite sheet.
+	//!
+	//! The movie is loaded once and the frames are captured in order, each of them after a seek, so
+	//! the player never decodes more than what's needed to reach the next frame.
+	//!
+	//! @param path
+	//!		The movie.
+	//!
+	//! @param cancel
+	//!		Checked while decoding, decoding stops as soon as it's true.
+	//!
+	//! @param timeout
+	//!		Maximum number of milliseconds to spend on the movie.
+	//!
+	//! @param frames
+	//!		Number of frames in the sheet. Frame i is taken at (i + 0.5) / frames of the duration.
+	//!
+	//! @param size
+	//!		Each frame is downscaled to fit in this size.
+	//!
+	//! @param timedOut
+	//!		Set to true if the timeout was reached.
+	//!
+	//! @return
+	//!		The frames laid out left to right in a single row, or a null image on error, timeout or
+	//!		cancellation. Cells whose frame couldn't be captured, or which got the same frame as the
+	//!		previous cell, are left black.
+	//!
+	QImage MovieDecoder::DecodeStrip(const QString & path, std::atomic_bool & cancel, int timeout, int frames, const QSize & size, bool & timedOut)
+	{
+		const QDeadlineTimer deadline(timeout);
+		if (frames <= 0 || this->Load(path, cancel, deadline, timedOut) == false || m_Player->duration() <= 0)
+		{
+			this->Unload();
+			return QImage();
+		}
+
+		QImage sheet;
+		qint64 previous = -1;
+		const qint64 duration = m_Player->duration();
+		for (int i = 0; i < frames && m_Failed == false && timedOut == false && cancel == false; ++i)
+		{
+			// reject the frame of the previous cell, presented again by the player
+			QImage frame = this->Capture(static_cast< qint64 >(duration * ((i + 0.5) / frames)), size, cancel, deadline, timedOut);
+			const qint64 time = m_Output->GetFrameTime();
+			if (frame.isNull() == true || (time >= 0 && time == previous))
+			{
+				continue;
+			}
+			previous = time;
+
+			// the first frame gives the size of the cells
+			if (sheet.isNull() == true)
+			{
+				sheet = QImage(frame.width() * frames, frame.height(), QImage::Format_RGB32);
+				sheet.fill(Qt::black);
+			}
+			if (frame.size() != QSize(sheet.width() / frames, sheet.height()))
+			{
+				frame = Downscale(frame, QSize(sheet.width() / frames, sheet.height()));
+			}
+			frame = frame.convertToFormat(QImage::Format_RGB32);
+
+			// copy it in its cell
+			const int x = i * frame.width();
+			for (int y = 0; y < frame.height(); ++y)
+			{
+				memcpy(sheet.scanLine(y) + x * 4, frame.constScanLine(y), static_cast< size_t >(frame.width()) * 4);
+			}
+		}
+
+		this->Unload();
+		if (timedOut == true)
+		{
+			qDebug() << "timeout while generating strip for " << path;
+		}
+		return cancel == false && timedOut == false ? sheet : QImage();
+	}
+
+	//!
+	//! Load a movie, and wait until it's ready to be played.
+	//!
+	//! @return
+	//!		false if the movie couldn't be loaded.
+	//!
+	bool MovieDecoder::Load(const QString & path, std::atomic_bool & cancel, const QDeadlineTimer & deadline, bool & timedOut)
+	{
+		timedOut = false;
+		if (cancel == true)
+		{
+			return false;
+		}
+
+		m_Path = path;
+		m_Loaded = false;
+		m_Failed = false;
+		m_Player->setMedia(QUrl::fromLocalFile(path));
+		timedOut = this->Wait(cancel, deadline, [this] (void) { return m_Loaded == true || m_Failed == true; }) == false;
+		return m_Loaded == true && m_Failed == false && timedOut == false && cancel == false;
+	}
+
+	//!
+	//! Capture the frame at the given position of the loaded movie.
+	//!
+	//! The frames presented before the position is reached (frames queued before the seek, or
+	//! decoded from the previous keyframe) are skipped, so if the seek doesn't happen the capture
+	//! times out instead of returning a frame from somewhere else in the movie.
+	//!
+	//! @param position
+	//!		Position in milliseconds, or -1 to capture the next frame.
+	//!
+	QImage MovieDecoder::Capture(qint64 position, const QSize & size, std::atomic_bool & cancel, const QDeadlineTimer & deadline, bool & timedOut)
+	{
+		// seeking is done before playing, so playback starts from the nearest keyframe. Seeks are
+		// ignored until the player reports the movie as seekable
+		if (position >= 0)
+		{
+			timedOut = this->Wait(cancel, deadline, [this] (void) { return m_Player->isSeekable() == true || m_Failed == true; }) == false;
+			if (timedOut == true || m_Failed == true || cancel == true)
+			{
+				return QImage();
+			}
+			m_Player->setPosition(position);
+		}
+		m_Output->Capture(m_Path, 10, size, position);
+		m_Player->play();
+		timedOut = this->Wait(cancel, deadline, [this] (void) { return m_Output->IsCapturing() == false || m_Failed == true; }) == false;
+		m_Output->Stop();
+		m_Player->pause();
+		return m_Output->GetFrame();
+	}
+
+	//!
+	//! Release the movie, but keep the player for the next one
+	//!
+	void MovieDecoder::Unload(void)
+	{
+		m_Player->stop();
+		m_Player->setMedia(QMediaContent());
+		m_Path.clear();
+	}
+
+	//!
+	//! Run the player until a condition is met.
+	//!
+	//! @return
+	//!		false if the deadline was reached.
+	//!
+	bool MovieDecoder::Wait(std::atomic_bool & cancel, const QDeadlineTimer & deadline, const std::function< bool (void) > & done)
+	{
+		if (done() == true)
+		{
+			return true;
+		}
+		if (deadline.hasExpired() == true)
+		{
+			return false;
+		}
+
+		// stop the loop on timeout. The condition and the cancellation are also polled, since the
+		// loop might be stopped before it was started
+		bool timedOut = false;
+		QTimer timer;
+		timer.setSingleShot(true);
+		QObject::connect(&timer, &QTimer::timeout, [&] (void) {
+			timedOut = true;
+			m_Loop.quit();
+		});
+		QTimer poll;
+		QObject::connect(&poll, &QTimer::timeout, [&] (void) {
+			if (cancel == true || done() == true)
+			{
+				m_Loop.quit();
+			}
+		});
+		timer.start(static_cast< int >(deadline.remainingTime()));
+		poll.start(50);
+		m_Loop.exec();
+		return timedOut == false;
+	}
+
+	//!
+	//! Storage of the decoders of each thread. They're deleted when their thread exits.
+	//!
+	static QThreadStorage< MovieDecoder * > Decoders;
+
+	//!
+	//! Get the decoder of the current thread, creating it if needed
+	//!
+	MovieDecoder & MovieDecoder::GetThreadDecoder(void)
+	{
+		if (Decoders.hasLocalData() == false)
+		{
+			// note: not tracked, since QThreadStorage deletes it with a plain delete
+			Decoders.setLocalData(new MovieDecoder());
+		}
+		return *Decoders.localData();
+	}
+
+	//!
+	//! Delete the decoder of the current thread. Used when the backend seems stuck, the next call to
+	//! GetThreadDecoder will create a fresh one.
+	//!
+	void MovieDecoder::ReleaseThreadDecoder(void)
+	{
+		Decoders.setLocalData(nullptr);
+	}
+
+
+	//!
+	//! Constructor
+	//!
+	VideoCapture::VideoCapture(QEventLoop & loop)
+		: m_Loop(loop)
+		, m_Capture(false)
+		, m_Retries(0)
+		, m_Position(-1)
+		, m_FrameTime(-1)
+	{
+	}
+
+	//!
+	//! Enable capture for the next presented frame
+	//!
+	//! @param path
+	//!		The movie, for debugging.
+	//!
+	//! @param retries
+	//!		Number of invalid frames to skip before giving up.
+	//!
+	//! @param size
+	//!		The frame is downscaled to fit in this size while being captured. Use an invalid size to
+	//!		capture it at full resolution.
+	//!
+	//! @param position
+	//!		Frames ending before this position (in milliseconds) are skipped, and don't count as
+	//!		retries. Use -1 to capture the next frame.
+	//!
+	void VideoCapture::Capture(const QString & path, int retries, const QSize & size, qint64 position)
+	{
+		m_Path = path;
+		m_Size = size;
+		m_Frame = QImage();
+		m_FrameTime = -1;
+		m_Retries = retries;
+		m_Position = position;
+		m_Capture = true;
+	}
+
+	//!
+	//! Check if a capture is pending
+	//!
+	bool VideoCapture::IsCapturing(void) const
+	{
+		return m_Capture;
+	}
+
+	//!
+	//! Disable capture
+	//!
+	void VideoCapture::Stop(void)
+	{
+		m_Capture = false;
+	}
+
+	//!
+	//! Get the captured frame
+	//!
+	const QImage & VideoCapture::GetFrame(void) const
+	{
+		return m_Frame;
+	}
+
+	//!
+	//! Get the start time of the captured frame, in milliseconds, or -1 if unknown
+	//!
+	qint64 VideoCapture::GetFrameTime(void) const
+	{
+		return m_FrameTime;
+	}
+
+	//!
+	//! Downscale a mapped frame directly into an image of the given size. Full resolution frames are
+	//! never copied, except for the few formats the downscaler doesn't support.
+	//!
+	static QImage DownscaleFrame(const QVideoFrame & frame, const QSize & size)
+	{
+		switch (frame.pixelFormat())
+		{
+			// planar YUV formats: the planes are downscaled, then converted
+			case QVideoFrame::Format_NV12:
+			case QVideoFrame::Format_NV21:
+			case QVideoFrame::Format_YUV420P:
+			case QVideoFrame::Format_YV12:
+			{
+				const bool interleaved = frame.pixelFormat() == QVideoFrame::Format_NV12 || frame.pixelFormat() == QVideoFrame::Format_NV21;
+				if (frame.planeCount() != (interleaved == true ? 2 : 3))
+				{
+					return QImage();
+				}
+				const uchar * u = nullptr;
+				const uchar * v = nullptr;
+				switch (frame.pixelFormat())
+				{
+					case QVideoFrame::Format_NV12:		u = frame.bits(1);		v = frame.bits(1) + 1;	break;
+					case QVideoFrame::Format_NV21:		u = frame.bits(1) + 1;	v = frame.bits(1);		break;
+					case QVideoFrame::Format_YUV420P:	u = frame.bits(1);		v = frame.bits(2);		break;
+					default:							u = frame.bits(2);		v = frame.bits(1);		break;
+				}
+				QImage image(size, QImage::Format_RGB32);
+				if (DownscaleYUV420(frame.bits(0), frame.bytesPerLine(0), u, v, frame.bytesPerLine(1), interleaved, frame.width(), frame.height(), image) == false)
+				{
+					return QImage();
+				}
+				return image;
+			}
+
+			// compressed frames need to be decoded first
+			case QVideoFrame::Format_Jpeg:
+			{
+				return Downscale(QImage::fromData(frame.bits(), frame.mappedBytes(), "JPG"), size);
+			}
+
+			// RGB formats: wrap the mapped frame in an image, without copying it
+			default:
+			{
+				const QImage::Format format = QVideoFrame::imageFormatFromPixelFormat(frame.pixelFormat());
+				if (format == QImage::Format_Invalid)
+				{
+					return QImage();
+				}
+				const QImage wrapper(frame.bits(), frame.width(), frame.height(), frame.bytesPerLine(), format);
+				return size == frame.size() ? wrapper.copy() : Downscale(wrapper, size);
+			}
+		}
+	}
+
+	//!
+	//! Reimplemented from QAbstractVideoSurface. This is called whenever a new frame is available.
+	//!
+	bool VideoCapture::present(const QVideoFrame & source)
+	{
+		if (m_Capture == false)
+		{
+			return true;
+		}
+
+		// skip the frames ending before the requested position. Frames without timestamps can't be
+		// checked, and are accepted
+		const qint64 position = m_Position;
+		if (position >= 0 && source.startTime() >= 0)
+		{
+			const qint64 end = source.endTime() > source.startTime() ? source.endTime() : source.startTime() + 1;
+			if (end <= position * 1000)
+			{
+				return true;
+			}
+		}
+
+		// avoid re-capturing
+		if (m_Retries.fetch_sub(1) <= 0)
+		{
+			m_Capture = false;
+		}
+
+		// check the frame
+		if (source.isValid() == false)
+		{
+			qDebug() << m_Path << " - invalid frame - " << this->error();
+			if (m_Capture == false)
+			{
+				m_Loop.quit();
+			}
+			return false;
+		}
+
+		// map our frame (we need to make a local copy since we receive the frame as an immutable reference)
+		QVideoFrame frame(source);
+		if (frame.map(QAbstractVideoBuffer::MapMode::ReadOnly) == false)
+		{
+			qDebug() << m_Path << " - failed mapping frame - " << this->error();
+			if (m_Capture == false)
+			{
+				m_Loop.quit();
+			}
+			return false;
+		}
+
+		// downscale it straight from the mapped buffer
+		QSize size = frame.size();
+		if (m_Size.isValid() == true && (size.width() > m_Size.width() || size.height() > m_Size.height()))
+		{
+			size = size.scaled(m_Size, Qt::KeepAspectRatio).expandedTo({ 1, 1 });
+		}
+		const QImage captured = DownscaleFrame(frame, size);
+		frame.unmap();
+		if (captured.isNull() == true)
+		{
+			qDebug() << m_Path << " - invalid format - " << source.pixelFormat();
+			if (m_Capture == false)
+			{
+				m_Loop.quit();
+			}
+			return false;
+		}
+
+		// store the captured frame, ignore the next ones, and stop the loop
+		m_Frame = captured;
+		m_FrameTime = source.startTime() >= 0 ? source.startTime() / 1000 : -1;
+		m_Capture = false;
+		m_Loop.quit();
+
+		// and done !
+		return true;
+	}
+
+	//!
+	//! Reimplemented from QAbstractVideoSurface.
+	//!
+	QList< QVideoFrame::PixelFormat > VideoCapture::supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const
+	{
+		Q_UNUSED(type);
+		return {
+			// decoders usually output those, so they're preferred to avoid a conversion by the backend
+			QVideoFrame::Format_NV12,
+			QVideoFrame::Format_NV21,
+			QVideoFrame::Format_YUV420P,
+			QVideoFrame::Format_YV12,
+			QVideoFrame::Format_RGB24,
+			QVideoFrame::Format_RGB32,
+			QVideoFrame::Format_RGB555,
+			QVideoFrame::Format_RGB565,
+			QVideoFrame::Format_BGR24,
+			QVideoFrame::Format_BGR32,
+			QVideoFrame::Format_BGR555,
+			QVideoFrame::Format_BGR565,
+			QVideoFrame::Format_BGRA32,
+			QVideoFrame::Format_BGRA32_Premultiplied,
+			QVideoFrame::Format_BGRA5658_Premultiplied,
+			QVideoFrame::Format_ARGB32,
+			QVideoFrame::Format_ARGB32_Premultiplied,
+			QVideoFrame::Format_ARGB8565_Premultiplied,
+			QVideoFrame::Format_Jpeg
+		};
+	}
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QAbstractVideoSurface>
+#include <QDeadlineTimer>
+#include <QEventLoop>
+#include <QImage>
+
+#include <atomic>
+#include <functional>
+
+
+class QMediaPlayer;
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Utility class used with a QMediaPlayer to capture a frame of a movie.
+	//!
+	class VideoCapture
+		: public QAbstractVideoSurface
+	{
+
+	public:
+
+		// Constructor
+		VideoCapture(QEventLoop & loop);
+
+		// API
+		void			Capture(const QString & path, int retries, const QSize & size, qint64 position);
+		bool			IsCapturing(void) const;
+		void			Stop(void);
+		const QImage &	GetFrame(void) const;
+		qint64			GetFrameTime(void) const;
+
+	protected:
+
+		// Reimplemented from QAbstractVideoSurface
+		bool								present(const QVideoFrame & source) override;
+		QList< QVideoFrame::PixelFormat >	supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const override;
+
+	private:
+
+		//! The movie path (for debugging only)
+		QString m_Path;
+
+		//! The captured frame is downscaled to fit in this size
+		QSize m_Size;
+
+		//! Stopped when a frame was captured, or in case of errors
+		QEventLoop & m_Loop;
+
+		//! When true, the next presented frame will be captured
+		std::atomic_bool m_Capture;
+
+		//! Number of times to retry capturing
+		std::atomic_int m_Retries;
+
+		//! Frames ending before this position (in milliseconds) are skipped. -1 to capture any frame
+		std::atomic< qint64 > m_Position;
+
+		//! The captured frame
+		QImage m_Frame;
+
+		//! Start time of the captured frame, in milliseconds, or -1 if unknown
+		qint64 m_FrameTime;
+
+	};
+
+
+	//!
+	//! Long lived movie decoding context, used to capture frames of movies.
+	//!
+	//! Creating a media player is a lot more expensive than decoding a frame, so each thread which
+	//! generates movie previews keeps its own decoder and reuses it for every movie.
+	//!
+	class MovieDecoder
+	{
+
+	public:
+
+		MovieDecoder(void);
+		~MovieDecoder(void);
+
+		// public API
+		QImage					Decode(const QString & path, std::atomic_bool & cancel, int timeout, double position, int candidates, const QSize & size, bool & timedOut);
+		QImage					DecodeStrip(const QString & path, std::atomic_bool & cancel, int timeout, int frames, const QSize & size, bool & timedOut);
+		static MovieDecoder &	GetThreadDecoder(void);
+		static void				ReleaseThreadDecoder(void);
+
+	private:
+
+		// private API
+		bool	Load(const QString & path, std::atomic_bool & cancel, const QDeadlineTimer & deadline, bool & timedOut);
+		QImage	Capture(qint64 position, const QSize & size, std::atomic_bool & cancel, const QDeadlineTimer & deadline, bool & timedOut);
+		void	Unload(void);
+		bool	Wait(std::atomic_bool & cancel, const QDeadlineTimer & deadline, const std::function< bool (void) > & done);
+
+		//! The loop in which the player runs while decoding
+		QEventLoop m_Loop;
+
+		//! The player
+		QMediaPlayer * m_Player;
+
+		//! The surface capturing the frame
+		VideoCapture * m_Output;
+
+		//! Path of the movie being decoded
+		QString m_Path;
+
+		//! Set when the movie is loaded
+		bool m_Loaded;
+
+		//! Set when the movie couldn't be loaded or played
+		bool m_Failed;
+
+	};
+
+}
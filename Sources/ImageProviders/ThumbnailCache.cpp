@@ -0,0 +1,1089 @@
+#include "ThumbnailCache.h"
+
+#include "CppUtils/MemoryTracker.h"
+#include "Utils/Job.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#include <algorithm>
+
+#if defined(WINDOWS)
+#	include <io.h>
+#	include <windows.h>
+#else
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Magic number at the beginning of each record ("MVTC")
+	//!
+	static constexpr uint32_t RecordMagic = 0x4354564d;
+
+	//!
+	//! Magic number at the beginning of the index ("MVTI")
+	//!
+	static constexpr uint32_t IndexMagic = 0x4954564d;
+
+	//!
+	//! Version of the index layout. Increment when IndexHeader or Entry change.
+	//!
+	static constexpr uint32_t IndexVersion = 1;
+
+	//!
+	//! Initial number of entries of the index
+	//!
+	static constexpr uint32_t InitialCapacity = 4096;
+
+	//!
+	//! Bounds of the size after which a new shard is started. Within those bounds, shards are sized
+	//! relative to the budget, so that evicted records are reclaimed by compacting shards regularly.
+	//!
+	static constexpr uint64_t MinShardSize = 4 * 1024 * 1024;
+	static constexpr uint64_t MaxShardSize = 256 * 1024 * 1024;
+
+	//!
+	//! Sanity limit on the size of a single thumbnail, used to detect corrupted headers
+	//!
+	static constexpr uint32_t MaxRecordLength = 64 * 1024 * 1024;
+
+	//!
+	//! 64 bits FNV-1a hash. Used for the keys and checksums since it gives the same results on every
+	//! platform and CPU, which is needed for something that's persisted on disk.
+	//!
+	static uint64_t Fnv1a(const void * data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const uint8_t * bytes = static_cast< const uint8_t * >(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//!
+	//! Checksum of a thumbnail data
+	//!
+	static uint32_t Checksum(const QByteArray & data)
+	{
+		const uint64_t hash = Fnv1a(data.constData(), size_t(data.size()));
+		return static_cast< uint32_t >(hash ^ (hash >> 32));
+	}
+
+	//!
+	//! Current time, as stored in the index entries
+	//!
+	static uint32_t Now(void)
+	{
+		return static_cast< uint32_t >(QDateTime::currentSecsSinceEpoch());
+	}
+
+	//!
+	//! Get the preferred slot of a key in the index. FNV-1a's low bits are not well distributed, so
+	//! the key goes through a finalizer first.
+	//!
+	static uint32_t Slot(uint64_t key, uint32_t capacity)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return static_cast< uint32_t >(key) & (capacity - 1);
+	}
+
+	//!
+	//! Read @p size bytes at @p offset in a file, without touching the file's current position.
+	//! This is a single pread on POSIX systems, and can be used concurrently from several threads.
+	//!
+	static bool ReadAt(const QFile & file, uint64_t offset, char * buffer, qint64 size)
+	{
+#if defined(WINDOWS)
+		OVERLAPPED overlapped = {};
+		overlapped.Offset		= static_cast< DWORD >(offset & 0xffffffff);
+		overlapped.OffsetHigh	= static_cast< DWORD >(offset >> 32);
+		DWORD read = 0;
+		HANDLE handle = reinterpret_cast< HANDLE >(_get_osfhandle(file.handle()));
+		return ReadFile(handle, buffer, static_cast< DWORD >(size), &read, &overlapped) == TRUE && read == static_cast< DWORD >(size);
+#else
+		return ::pread(file.handle(), buffer, static_cast< size_t >(size), static_cast< off_t >(offset)) == size;
+#endif
+	}
+
+	//!
+	//! Constructor
+	//!
+	ThumbnailCache::ThumbnailCache(void)
+		: m_Header(nullptr)
+		, m_Entries(nullptr)
+		, m_Active(0)
+		, m_ActiveSize(0)
+		, m_MaxShardSize(MaxShardSize)
+		, m_Budget(0)
+		, m_Maintaining(false)
+	{
+		m_Pool.setMaxThreadCount(1);
+	}
+
+	//!
+	//! Destructor
+	//!
+	ThumbnailCache::~ThumbnailCache(void)
+	{
+		this->Close();
+	}
+
+	//!
+	//! Open the store located in the given folder.
+	//!
+	bool ThumbnailCache::Open(const QString & path)
+	{
+		this->Close();
+
+		QMutexLocker writeLock(&m_WriteMutex);
+		m_Path = path;
+		if (QDir().mkpath(m_Path) == false)
+		{
+			qDebug() << "failed creating thumbnail cache folder " << m_Path;
+			return false;
+		}
+
+		// get the existing shards, in creation order
+		QVector< uint32_t > ids;
+		for (const QString & name : QDir(m_Path).entryList({ "Thumbnails.*.dat" }, QDir::Files, QDir::NoSort))
+		{
+			bool ok = false;
+			const uint32_t id = name.section('.', 1, 1).toUInt(&ok);
+			if (ok == true)
+			{
+				ids.push_back(id);
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+
+		// load the index
+		{
+			QWriteLocker lock(&m_Lock);
+			if (this->LoadIndex(ids) == false)
+			{
+				return false;
+			}
+		}
+
+		// and start appending to the last shard
+		if (this->OpenWriter(ids.isEmpty() == false ? ids.back() : 0) == false)
+		{
+			return false;
+		}
+
+		// the previous session might have ended before compacting, or the budget might have changed
+		writeLock.unlock();
+		this->ScheduleMaintenance();
+		return true;
+	}
+
+	//!
+	//! Close the store. This waits for any running maintenance to finish.
+	//!
+	void ThumbnailCache::Close(void)
+	{
+		m_Pool.waitForDone();
+
+		QMutexLocker writeLock(&m_WriteMutex);
+		QWriteLocker lock(&m_Lock);
+		m_Writer.close();
+		this->UnmapIndex(true);
+		m_IndexFile.close();
+		for (Shard & shard : m_Shards)
+		{
+			MT_DELETE shard.File;
+		}
+		m_Shards.clear();
+		m_Active = 0;
+		m_ActiveSize = 0;
+	}
+
+	//!
+	//! Remove every thumbnail from the store.
+	//!
+	void ThumbnailCache::Clear(void)
+	{
+		const QString path = m_Path;
+		this->Close();
+		QDir(path).removeRecursively();
+		this->Open(path);
+	}
+
+	//!
+	//! Get a thumbnail.
+	//!
+	//! @param key
+	//!		The key of the thumbnail (see GetKey)
+	//!
+	//! @param source
+	//!		The current state of the source media (see GetSource) If it doesn't match the one stored
+	//!		with the thumbnail, the thumbnail is considered stale and this method returns false.
+	//!
+	//! @param data
+	//!		Receives the encoded thumbnail.
+	//!
+	bool ThumbnailCache::Get(uint64_t key, const Source & source, QByteArray & data) const
+	{
+		QReadLocker lock(&m_Lock);
+		const Entry * entry = this->Find(key);
+		if (entry == nullptr || entry->Size != source.Size || entry->Date != source.Date)
+		{
+			return false;
+		}
+
+		// update the access time. Readers can do that concurrently, hence the atomic store
+		static_assert(sizeof(std::atomic< uint32_t >) == sizeof(uint32_t), "can't update the access time atomically");
+		reinterpret_cast< std::atomic< uint32_t > * >(const_cast< uint32_t * >(&entry->Access))->store(Now(), std::memory_order_relaxed);
+
+		return this->Read(*entry, data);
+	}
+
+	//!
+	//! Add or replace a thumbnail.
+	//!
+	//! @param key
+	//!		The key of the thumbnail (see GetKey)
+	//!
+	//! @param source
+	//!		The state of the source media (see GetSource)
+	//!
+	//! @param size
+	//!		The dimensions of the thumbnail
+	//!
+	//! @param data
+	//!		The encoded thumbnail
+	//!
+	bool ThumbnailCache::Put(uint64_t key, const Source & source, const QSize & size, const QByteArray & data)
+	{
+		if (data.isEmpty() == true)
+		{
+			return false;
+		}
+
+		// append the record
+		QMutexLocker writeLock(&m_WriteMutex);
+		Header header = {};
+		header.Key		= key;
+		header.Size		= source.Size;
+		header.Date		= source.Date;
+		header.Width	= static_cast< uint16_t >(qBound(0, size.width(), 0xffff));
+		header.Height	= static_cast< uint16_t >(qBound(0, size.height(), 0xffff));
+		uint32_t shard = 0;
+		uint64_t offset = 0;
+		if (this->Append(header, data, shard, offset) == false)
+		{
+			return false;
+		}
+
+		// and update the index
+		bool maintain = false;
+		{
+			QWriteLocker lock(&m_Lock);
+			const uint32_t length = static_cast< uint32_t >(data.size());
+			Entry * entry = this->Insert(key);
+			if (entry == nullptr)
+			{
+				m_Shards[shard].Dead += RecordSize(length);
+				return false;
+			}
+
+			// new entries are zeroed, and thumbnails are never empty
+			if (entry->Length != 0)
+			{
+				Shard & old = m_Shards[entry->Shard];
+				old.Live -= RecordSize(entry->Length);
+				old.Dead += RecordSize(entry->Length);
+				maintain = entry->Shard != m_Active && old.Dead >= old.Live;
+			}
+
+			entry->Size		= source.Size;
+			entry->Date		= source.Date;
+			entry->Offset	= offset;
+			entry->Shard	= shard;
+			entry->Length	= length;
+			entry->Width	= header.Width;
+			entry->Height	= header.Height;
+			entry->Access	= Now();
+			m_Shards[shard].Live += RecordSize(length);
+			maintain = maintain || this->NeedsEviction();
+		}
+
+		writeLock.unlock();
+		if (maintain == true)
+		{
+			this->ScheduleMaintenance();
+		}
+		return true;
+	}
+
+	//!
+	//! Get the size budget of the store, in bytes. 0 means no limit.
+	//!
+	uint64_t ThumbnailCache::GetBudget(void) const
+	{
+		return m_Budget;
+	}
+
+	//!
+	//! Set the size budget of the store, in bytes. 0 means no limit.
+	//!
+	void ThumbnailCache::SetBudget(uint64_t budget)
+	{
+		{
+			QMutexLocker writeLock(&m_WriteMutex);
+			m_Budget = budget;
+			m_MaxShardSize = budget == 0 ? MaxShardSize : qBound(MinShardSize, budget / 8, MaxShardSize);
+		}
+
+		bool evict = false;
+		{
+			QReadLocker lock(&m_Lock);
+			evict = this->NeedsEviction();
+		}
+		if (evict == true)
+		{
+			this->ScheduleMaintenance();
+		}
+	}
+
+	//!
+	//! Compute the key of a thumbnail. Never returns 0, which marks empty entries in the index.
+	//!
+	//! @param frames
+	//!		Number of frames of a movie strip, 0 for single thumbnails. It's only hashed when not 0,
+	//!		so that existing thumbnails keep their key.
+	//!
+	uint64_t ThumbnailCache::GetKey(const QString & path, int width, int height, int frames)
+	{
+		const QByteArray bytes = path.toUtf8();
+		uint64_t hash = Fnv1a(bytes.constData(), size_t(bytes.size()));
+		hash = Fnv1a(&width, sizeof(width), hash);
+		hash = Fnv1a(&height, sizeof(height), hash);
+		if (frames != 0)
+		{
+			hash = Fnv1a(&frames, sizeof(frames), hash);
+		}
+		return hash != 0 ? hash : 1;
+	}
+
+	//!
+	//! Get the current state of a source media.
+	//!
+	//! @return
+	//!		false if the source doesn't exist.
+	//!
+	bool ThumbnailCache::GetSource(const QString & path, Source & source)
+	{
+#if defined(WINDOWS)
+		const QFileInfo info(path);
+		if (info.exists() == false)
+		{
+			return false;
+		}
+		source.Size = info.size();
+		source.Date = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#else
+		struct stat info;
+		if (::stat(QFile::encodeName(path).constData(), &info) != 0)
+		{
+			return false;
+		}
+		source.Size = static_cast< int64_t >(info.st_size);
+#	if defined(MACOS)
+		source.Date = static_cast< int64_t >(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#	else
+		source.Date = static_cast< int64_t >(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#	endif
+#endif
+		return true;
+	}
+
+	//!
+	//! Size of a record on disk
+	//!
+	uint64_t ThumbnailCache::RecordSize(uint32_t length)
+	{
+		return sizeof(Header) + length;
+	}
+
+	//!
+	//! Get the path of a shard file
+	//!
+	QString ThumbnailCache::GetShardPath(uint32_t id) const
+	{
+		return QString("%1/Thumbnails.%2.dat").arg(m_Path).arg(id);
+	}
+
+	//!
+	//! Map the index and open the shards. The index is rebuilt from the shards if it's missing,
+	//! invalid, or if it was not properly closed. Caller must hold m_Lock.
+	//!
+	bool ThumbnailCache::LoadIndex(const QVector< uint32_t > & shards)
+	{
+		m_IndexFile.setFileName(m_Path + "/Thumbnails.index");
+		if (m_IndexFile.open(QIODevice::ReadWrite) == false)
+		{
+			qDebug() << "failed opening thumbnail cache index " << m_IndexFile.fileName() << " - " << m_IndexFile.errorString();
+			return false;
+		}
+
+		// check if the existing index can be used
+		bool valid = false;
+		IndexHeader header;
+		if (m_IndexFile.read(reinterpret_cast< char * >(&header), sizeof(IndexHeader)) == sizeof(IndexHeader) &&
+			header.Magic == IndexMagic &&
+			header.Version == IndexVersion &&
+			header.Clean == 1 &&
+			header.Capacity != 0 &&
+			(header.Capacity & (header.Capacity - 1)) == 0 &&
+			static_cast< uint64_t >(m_IndexFile.size()) == sizeof(IndexHeader) + uint64_t(header.Capacity) * sizeof(Entry))
+		{
+			valid = this->MapIndex(header.Capacity, false);
+		}
+
+		if (valid == true)
+		{
+			for (uint32_t id : shards)
+			{
+				this->AddShard(id);
+			}
+		}
+		else
+		{
+			// rebuild it. Records are only ever appended to the shard with the highest id, so processing
+			// them in order guarantees that the last record found for a given key is the most recent.
+			qDebug() << "rebuilding thumbnail cache index " << m_IndexFile.fileName();
+			if (this->MapIndex(InitialCapacity, true) == false)
+			{
+				return false;
+			}
+			for (uint32_t id : shards)
+			{
+				this->LoadShard(id);
+			}
+		}
+
+		// compute the shards usage, and drop entries pointing to missing shards
+		QVector< uint64_t > stale;
+		for (uint32_t i = 0; i < m_Header->Capacity; ++i)
+		{
+			const Entry & entry = m_Entries[i];
+			if (entry.Key != 0)
+			{
+				auto shard = m_Shards.find(entry.Shard);
+				if (shard != m_Shards.end())
+				{
+					shard->Live += RecordSize(entry.Length);
+				}
+				else
+				{
+					stale.push_back(entry.Key);
+				}
+			}
+		}
+		for (uint64_t key : stale)
+		{
+			this->Remove(key);
+		}
+		for (Shard & shard : m_Shards)
+		{
+			shard.Dead = qMax(static_cast< uint64_t >(shard.File->size()), shard.Live) - shard.Live;
+		}
+
+		// flag the index as dirty until it's closed
+		m_Header->Clean = 0;
+		return true;
+	}
+
+	//!
+	//! Map the index file, resizing it to the given capacity.
+	//!
+	//! @param capacity
+	//!		The number of entries. Must be a power of 2.
+	//!
+	//! @param clear
+	//!		If true, the index is reset to an empty one.
+	//!
+	bool ThumbnailCache::MapIndex(uint32_t capacity, bool clear)
+	{
+		Q_ASSERT(m_Header == nullptr);
+		const qint64 size = static_cast< qint64 >(sizeof(IndexHeader) + uint64_t(capacity) * sizeof(Entry));
+		if ((clear == true && m_IndexFile.resize(0) == false) || m_IndexFile.resize(size) == false)
+		{
+			qDebug() << "failed resizing thumbnail cache index " << m_IndexFile.fileName() << " - " << m_IndexFile.errorString();
+			return false;
+		}
+
+		uchar * memory = m_IndexFile.map(0, size);
+		if (memory == nullptr)
+		{
+			qDebug() << "failed mapping thumbnail cache index " << m_IndexFile.fileName() << " - " << m_IndexFile.errorString();
+			return false;
+		}
+		m_Header	= reinterpret_cast< IndexHeader * >(memory);
+		m_Entries	= reinterpret_cast< Entry * >(memory + sizeof(IndexHeader));
+
+		// the file is zero filled when resized, so only the header needs to be initialized
+		if (clear == true)
+		{
+			m_Header->Magic		= IndexMagic;
+			m_Header->Version	= IndexVersion;
+			m_Header->Capacity	= capacity;
+			m_Header->Count		= 0;
+			m_Header->Clean		= 0;
+		}
+		return true;
+	}
+
+	//!
+	//! Unmap the index.
+	//!
+	//! @param clean
+	//!		true if the index is consistent with the shards.
+	//!
+	void ThumbnailCache::UnmapIndex(bool clean)
+	{
+		if (m_Header != nullptr)
+		{
+			m_Header->Clean = clean == true ? 1 : 0;
+			m_IndexFile.unmap(reinterpret_cast< uchar * >(m_Header));
+			m_Header = nullptr;
+			m_Entries = nullptr;
+		}
+	}
+
+	//!
+	//! Find the entry of a key in the index. Caller must hold m_Lock.
+	//!
+	const ThumbnailCache::Entry * ThumbnailCache::Find(uint64_t key) const
+	{
+		if (m_Header == nullptr)
+		{
+			return nullptr;
+		}
+
+		// the load factor is kept under 75%, so there's always an empty entry to stop on
+		const uint32_t mask = m_Header->Capacity - 1;
+		for (uint32_t i = Slot(key, m_Header->Capacity); ; i = (i + 1) & mask)
+		{
+			const Entry & entry = m_Entries[i];
+			if (entry.Key == key)
+			{
+				return &entry;
+			}
+			if (entry.Key == 0)
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	//!
+	//! Find the entry of a key in the index. Caller must hold m_Lock for writing.
+	//!
+	ThumbnailCache::Entry * ThumbnailCache::Find(uint64_t key)
+	{
+		return const_cast< Entry * >(static_cast< const ThumbnailCache * >(this)->Find(key));
+	}
+
+	//!
+	//! Get the entry of a key, inserting a zeroed one if it doesn't exist yet. The index grows as
+	//! needed, which invalidates any previously returned entry. Caller must hold m_Lock for writing.
+	//!
+	ThumbnailCache::Entry * ThumbnailCache::Insert(uint64_t key)
+	{
+		if (m_Header == nullptr)
+		{
+			return nullptr;
+		}
+
+		// grow the table
+		if ((uint64_t(m_Header->Count) + 1) * 4 > uint64_t(m_Header->Capacity) * 3)
+		{
+			QVector< Entry > entries;
+			entries.reserve(static_cast< int >(m_Header->Count));
+			for (uint32_t i = 0; i < m_Header->Capacity; ++i)
+			{
+				if (m_Entries[i].Key != 0)
+				{
+					entries.push_back(m_Entries[i]);
+				}
+			}
+
+			const uint32_t capacity = m_Header->Capacity * 2;
+			this->UnmapIndex(false);
+			if (this->MapIndex(capacity, true) == false)
+			{
+				return nullptr;
+			}
+			for (const Entry & entry : entries)
+			{
+				*this->Insert(entry.Key) = entry;
+			}
+		}
+
+		// find the entry
+		const uint32_t mask = m_Header->Capacity - 1;
+		for (uint32_t i = Slot(key, m_Header->Capacity); ; i = (i + 1) & mask)
+		{
+			Entry & entry = m_Entries[i];
+			if (entry.Key == key)
+			{
+				return &entry;
+			}
+			if (entry.Key == 0)
+			{
+				entry.Key = key;
+				++m_Header->Count;
+				return &entry;
+			}
+		}
+	}
+
+	//!
+	//! Remove a key from the index. Uses backward shift deletion, so that lookups never need to
+	//! skip over tombstones. Caller must hold m_Lock for writing.
+	//!
+	void ThumbnailCache::Remove(uint64_t key)
+	{
+		Entry * entry = this->Find(key);
+		if (entry == nullptr)
+		{
+			return;
+		}
+
+		const uint32_t mask = m_Header->Capacity - 1;
+		uint32_t hole = static_cast< uint32_t >(entry - m_Entries);
+		for (uint32_t i = (hole + 1) & mask; m_Entries[i].Key != 0; i = (i + 1) & mask)
+		{
+			// an entry can be moved to the hole if its preferred slot is not between the hole and itself
+			const uint32_t slot = Slot(m_Entries[i].Key, m_Header->Capacity);
+			const bool stays = hole <= i ? (hole < slot && slot <= i) : (hole < slot || slot <= i);
+			if (stays == false)
+			{
+				m_Entries[hole] = m_Entries[i];
+				hole = i;
+			}
+		}
+		m_Entries[hole] = {};
+		--m_Header->Count;
+	}
+
+	//!
+	//! Add the records of a shard to the index.
+	//!
+	//! Only the headers are read, except for the last record of the shard which is fully checked:
+	//! this is where a crash during an append would leave a torn record. Anything after the first
+	//! invalid record is truncated. Caller must hold m_Lock.
+	//!
+	bool ThumbnailCache::LoadShard(uint32_t id)
+	{
+		QFile file(this->GetShardPath(id));
+		if (file.open(QIODevice::ReadWrite) == false)
+		{
+			qDebug() << "failed opening thumbnail cache shard " << file.fileName() << " - " << file.errorString();
+			return false;
+		}
+
+		if (this->AddShard(id) == false)
+		{
+			return false;
+		}
+
+		const uint64_t size = static_cast< uint64_t >(file.size());
+		uint64_t offset = 0;
+		Header header;
+		while (offset + sizeof(Header) <= size)
+		{
+			// read and check the header
+			if (file.seek(static_cast< qint64 >(offset)) == false ||
+				file.read(reinterpret_cast< char * >(&header), sizeof(Header)) != sizeof(Header) ||
+				header.Magic != RecordMagic ||
+				header.Length == 0 ||
+				header.Length > MaxRecordLength ||
+				offset + RecordSize(header.Length) > size)
+			{
+				break;
+			}
+
+			// the last record might be partially written
+			if (offset + RecordSize(header.Length) == size &&
+				Checksum(file.read(header.Length)) != header.Checksum)
+			{
+				break;
+			}
+
+			// update the index
+			Entry * entry = this->Insert(header.Key);
+			if (entry == nullptr)
+			{
+				return false;
+			}
+			entry->Size		= header.Size;
+			entry->Date		= header.Date;
+			entry->Offset	= offset;
+			entry->Shard	= id;
+			entry->Length	= header.Length;
+			entry->Width	= header.Width;
+			entry->Height	= header.Height;
+			entry->Access	= 0;
+
+			offset += RecordSize(header.Length);
+		}
+
+		// remove what's left
+		if (offset != size)
+		{
+			qDebug() << "truncating corrupted thumbnail cache shard " << file.fileName() << " at " << offset;
+			file.resize(static_cast< qint64 >(offset));
+		}
+		return true;
+	}
+
+	//!
+	//! Add a shard to the list of shards, opening its read handle. Caller must hold m_Lock.
+	//!
+	bool ThumbnailCache::AddShard(uint32_t id)
+	{
+		if (m_Shards.contains(id) == true)
+		{
+			return true;
+		}
+
+		QFile * file = MT_NEW QFile(this->GetShardPath(id));
+		if (file->open(QIODevice::ReadOnly) == false)
+		{
+			qDebug() << "failed opening thumbnail cache shard " << file->fileName() << " - " << file->errorString();
+			MT_DELETE file;
+			return false;
+		}
+		m_Shards[id].File = file;
+		return true;
+	}
+
+	//!
+	//! Make the given shard the active one, creating it if needed.
+	//! Caller must hold m_WriteMutex, and not m_Lock.
+	//!
+	bool ThumbnailCache::OpenWriter(uint32_t id)
+	{
+		m_Writer.close();
+		m_Writer.setFileName(this->GetShardPath(id));
+		if (m_Writer.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered) == false)
+		{
+			qDebug() << "failed opening thumbnail cache shard " << m_Writer.fileName() << " - " << m_Writer.errorString();
+			return false;
+		}
+
+		QWriteLocker lock(&m_Lock);
+		if (this->AddShard(id) == false)
+		{
+			m_Writer.close();
+			return false;
+		}
+		m_Active = id;
+		m_ActiveSize = static_cast< uint64_t >(m_Writer.size());
+		return true;
+	}
+
+	//!
+	//! Append a record to the active shard, starting a new shard when it becomes too big.
+	//! Caller must hold m_WriteMutex, and not m_Lock.
+	//!
+	//! @param header
+	//!		The header of the record. Magic, Length and Checksum are set by this method.
+	//!
+	bool ThumbnailCache::Append(Header header, const QByteArray & data, uint32_t & shard, uint64_t & offset)
+	{
+		const uint32_t length = static_cast< uint32_t >(data.size());
+		if (m_Writer.isOpen() == false || length > MaxRecordLength)
+		{
+			return false;
+		}
+
+		// start a new shard if needed
+		if (m_ActiveSize != 0 && m_ActiveSize + RecordSize(length) > m_MaxShardSize)
+		{
+			if (this->OpenWriter(m_Active + 1) == false)
+			{
+				return false;
+			}
+		}
+
+		// build the record, and write it in one go
+		header.Magic	= RecordMagic;
+		header.Length	= length;
+		header.Checksum	= Checksum(data);
+		QByteArray record;
+		record.reserve(static_cast< int >(RecordSize(length)));
+		record.append(reinterpret_cast< const char * >(&header), sizeof(Header));
+		record.append(data);
+		if (m_Writer.write(record) != record.size())
+		{
+			// don't leave a partial record in the middle of the shard
+			qDebug() << "failed writing to thumbnail cache shard " << m_Writer.fileName() << " - " << m_Writer.errorString();
+			m_Writer.resize(static_cast< qint64 >(m_ActiveSize));
+			return false;
+		}
+
+		shard = m_Active;
+		offset = m_ActiveSize;
+		m_ActiveSize += RecordSize(length);
+		return true;
+	}
+
+	//!
+	//! Read the data of a record. Caller must hold m_Lock.
+	//!
+	bool ThumbnailCache::Read(const Entry & entry, QByteArray & data) const
+	{
+		auto shard = m_Shards.constFind(entry.Shard);
+		if (shard == m_Shards.constEnd())
+		{
+			return false;
+		}
+
+		// read the whole record at once
+		QByteArray record(static_cast< int >(RecordSize(entry.Length)), Qt::Uninitialized);
+		if (ReadAt(*shard->File, entry.Offset, record.data(), record.size()) == false)
+		{
+			return false;
+		}
+
+		// check it
+		Header header;
+		memcpy(&header, record.constData(), sizeof(Header));
+		record.remove(0, sizeof(Header));
+		if (header.Magic != RecordMagic ||
+			header.Key != entry.Key ||
+			header.Length != entry.Length ||
+			header.Checksum != Checksum(record))
+		{
+			return false;
+		}
+
+		data = record;
+		return true;
+	}
+
+	//!
+	//! Get the number of bytes used by the live records. Caller must hold m_Lock.
+	//!
+	uint64_t ThumbnailCache::GetLiveSize(void) const
+	{
+		uint64_t size = 0;
+		for (const Shard & shard : m_Shards)
+		{
+			size += shard.Live;
+		}
+		return size;
+	}
+
+	//!
+	//! Check if the live records exceed the budget. Caller must hold m_Lock.
+	//!
+	bool ThumbnailCache::NeedsEviction(void) const
+	{
+		const uint64_t budget = m_Budget;
+		return budget != 0 && this->GetLiveSize() > budget;
+	}
+
+	//!
+	//! Start a background eviction and compaction if none is running
+	//!
+	void ThumbnailCache::ScheduleMaintenance(void)
+	{
+		if (m_Maintaining.exchange(true) == false)
+		{
+			MT_NEW Job([this] (void) {
+				this->Evict();
+				this->Compact();
+				m_Maintaining = false;
+			}, &m_Pool);
+		}
+	}
+
+	//!
+	//! If the live records exceed the budget, remove the least recently used thumbnails until they
+	//! use less than 90% of it. The evicted records become dead, and are reclaimed by Compact.
+	//!
+	void ThumbnailCache::Evict(void)
+	{
+		//! What we need to know about an entry to evict it
+		struct Candidate
+		{
+			uint32_t Access;
+			uint32_t Shard;
+			uint64_t Key;
+			uint64_t Offset;
+		};
+
+		// get the entries
+		const uint64_t budget = m_Budget;
+		uint64_t size = 0;
+		QVector< Candidate > candidates;
+		{
+			QReadLocker lock(&m_Lock);
+			if (m_Header == nullptr || this->NeedsEviction() == false)
+			{
+				return;
+			}
+			size = this->GetLiveSize();
+			candidates.reserve(static_cast< int >(m_Header->Count));
+			for (uint32_t i = 0; i < m_Header->Capacity; ++i)
+			{
+				const Entry & entry = m_Entries[i];
+				if (entry.Key != 0)
+				{
+					candidates.push_back({ entry.Access, entry.Shard, entry.Key, entry.Offset });
+				}
+			}
+		}
+
+		// least recently used first
+		std::sort(candidates.begin(), candidates.end(), [] (const Candidate & left, const Candidate & right) {
+			return left.Access < right.Access;
+		});
+
+		// and evict
+		const uint64_t target = budget / 10 * 9;
+		QWriteLocker lock(&m_Lock);
+		for (const Candidate & candidate : candidates)
+		{
+			if (size <= target)
+			{
+				break;
+			}
+
+			// the thumbnail might have been replaced in the meantime
+			const Entry * entry = this->Find(candidate.Key);
+			if (entry == nullptr || entry->Shard != candidate.Shard || entry->Offset != candidate.Offset)
+			{
+				continue;
+			}
+
+			const uint64_t bytes = RecordSize(entry->Length);
+			Shard & shard = m_Shards[entry->Shard];
+			shard.Live -= bytes;
+			shard.Dead += bytes;
+			size -= qMin(size, bytes);
+			this->Remove(candidate.Key);
+		}
+	}
+
+	//!
+	//! Move the live records of every shard which contains more dead bytes than live ones to the
+	//! active shard, and delete them.
+	//!
+	void ThumbnailCache::Compact(void)
+	{
+		for (;;)
+		{
+			// find a shard to compact, and the entries it still contains
+			uint32_t id = 0;
+			bool found = false;
+			QVector< Entry > entries;
+			{
+				QReadLocker lock(&m_Lock);
+				if (m_Header == nullptr)
+				{
+					return;
+				}
+				for (auto shard = m_Shards.constBegin(); shard != m_Shards.constEnd(); ++shard)
+				{
+					if (shard.key() != m_Active && shard->Dead >= shard->Live)
+					{
+						id = shard.key();
+						found = true;
+						break;
+					}
+				}
+				if (found == false)
+				{
+					return;
+				}
+				for (uint32_t i = 0; i < m_Header->Capacity; ++i)
+				{
+					if (m_Entries[i].Key != 0 && m_Entries[i].Shard == id)
+					{
+						entries.push_back(m_Entries[i]);
+					}
+				}
+			}
+
+			// move them
+			for (const Entry & entry : entries)
+			{
+				QByteArray data;
+				{
+					QReadLocker lock(&m_Lock);
+					if (this->Read(entry, data) == false)
+					{
+						continue;
+					}
+				}
+
+				QMutexLocker writeLock(&m_WriteMutex);
+				Header header = {};
+				header.Key		= entry.Key;
+				header.Size		= entry.Size;
+				header.Date		= entry.Date;
+				header.Width	= entry.Width;
+				header.Height	= entry.Height;
+				uint32_t shard = 0;
+				uint64_t offset = 0;
+				if (this->Append(header, data, shard, offset) == false)
+				{
+					continue;
+				}
+
+				// the thumbnail might have been replaced in the meantime, in which case our copy is dead
+				QWriteLocker lock(&m_Lock);
+				Entry * current = this->Find(entry.Key);
+				if (current != nullptr && current->Shard == id && current->Offset == entry.Offset)
+				{
+					current->Shard = shard;
+					current->Offset = offset;
+					m_Shards[shard].Live += RecordSize(entry.Length);
+				}
+				else
+				{
+					m_Shards[shard].Dead += RecordSize(entry.Length);
+				}
+			}
+
+			// and remove the shard, along with the entries we failed to move. Records are only appended
+			// to the active shard so nothing else can reference it, and readers hold m_Lock while
+			// reading so we can close it safely.
+			QWriteLocker lock(&m_Lock);
+			for (const Entry & entry : entries)
+			{
+				const Entry * current = this->Find(entry.Key);
+				if (current != nullptr && current->Shard == id)
+				{
+					this->Remove(entry.Key);
+				}
+			}
+			Shard shard = m_Shards.take(id);
+			MT_DELETE shard.File;
+			if (QFile::remove(this->GetShardPath(id)) == false)
+			{
+				qDebug() << "failed removing thumbnail cache shard " << this->GetShardPath(id);
+			}
+		}
+	}
+
+} // namespace MediaViewer
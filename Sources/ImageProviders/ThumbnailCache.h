@@ -0,0 +1,238 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Packed, append-only thumbnail store.
+	//!
+	//! Thumbnails are appended to a small set of shard files (`Thumbnails.<id>.dat`) located in the
+	//! cache folder. Each record is a fixed size header followed by the encoded thumbnail.
+	//!
+	//! The index is a memory mapped file (`Thumbnails.index`) containing an open addressing hash
+	//! table of fixed size entries keyed by the thumbnail key. An entry holds everything needed to
+	//! validate a cache hit and to locate the thumbnail data, so a hit costs a lookup in mapped memory
+	//! and a single positioned read, without parsing anything. The index is flagged as dirty while
+	//! the store is open, and rebuilt from the shards if it wasn't closed properly.
+	//!
+	//! Records are never modified in place: replacing a thumbnail appends a new record and marks the
+	//! old one as dead. When a shard contains more dead bytes than live ones, its remaining records
+	//! are moved to the active shard in the background and the shard is deleted.
+	//!
+	//! The store can be given a size budget. Each index entry records when its thumbnail was last
+	//! used, and when the live records exceed the budget, the least recently used thumbnails are
+	//! evicted in the background until the store is back under 90% of the budget.
+	//!
+	class ThumbnailCache
+	{
+
+	public:
+
+		//!
+		//! Information about the source media of a thumbnail, used to detect stale thumbnails.
+		//!
+		struct Source
+		{
+			//! Size of the source file in bytes
+			int64_t Size;
+
+			//! Last modification date of the source file, in nanoseconds since epoch
+			int64_t Date;
+		};
+
+		ThumbnailCache(void);
+		~ThumbnailCache(void);
+
+		// public API
+		bool			Open(const QString & path);
+		void			Close(void);
+		void			Clear(void);
+		bool			Get(uint64_t key, const Source & source, QByteArray & data) const;
+		bool			Put(uint64_t key, const Source & source, const QSize & size, const QByteArray & data);
+		uint64_t		GetBudget(void) const;
+		void			SetBudget(uint64_t budget);
+		static uint64_t	GetKey(const QString & path, int width, int height, int frames = 0);
+		static bool		GetSource(const QString & path, Source & source);
+
+	private:
+
+		//!
+		//! Header written in front of each thumbnail in the shard files.
+		//!
+		struct Header
+		{
+			//! Always RecordMagic, used to detect corrupted records
+			uint32_t Magic;
+
+			//! Size of the thumbnail data following the header
+			uint32_t Length;
+
+			//! Key of the thumbnail
+			uint64_t Key;
+
+			//! Source size at the time the thumbnail was generated
+			int64_t Size;
+
+			//! Source date at the time the thumbnail was generated
+			int64_t Date;
+
+			//! Checksum of the thumbnail data
+			uint32_t Checksum;
+
+			//! Dimensions of the thumbnail
+			uint16_t Width;
+			uint16_t Height;
+		};
+		static_assert(sizeof(Header) == 40, "the record header is persisted, its layout must not change");
+
+		//!
+		//! Header of the index file.
+		//!
+		struct IndexHeader
+		{
+			//! Always IndexMagic
+			uint32_t Magic;
+
+			//! Version of the index layout
+			uint32_t Version;
+
+			//! Number of entries in the table. Always a power of 2
+			uint32_t Capacity;
+
+			//! Number of used entries
+			uint32_t Count;
+
+			//! 1 when the store was properly closed, 0 while it's open
+			uint32_t Clean;
+
+			//! Unused
+			uint32_t Reserved[3];
+		};
+		static_assert(sizeof(IndexHeader) == 32, "the index header is persisted, its layout must not change");
+
+		//!
+		//! Entry of the index.
+		//!
+		struct Entry
+		{
+			//! Key of the thumbnail, 0 for empty entries
+			uint64_t Key;
+
+			//! Source size at the time the thumbnail was generated
+			int64_t Size;
+
+			//! Source date at the time the thumbnail was generated
+			int64_t Date;
+
+			//! Offset of the record in the shard
+			uint64_t Offset;
+
+			//! Identifier of the shard containing the record
+			uint32_t Shard;
+
+			//! Size of the thumbnail data
+			uint32_t Length;
+
+			//! Dimensions of the thumbnail
+			uint16_t Width;
+			uint16_t Height;
+
+			//! Last time the thumbnail was used, in seconds since epoch. 0 when unknown
+			uint32_t Access;
+		};
+		static_assert(sizeof(Entry) == 48, "index entries are persisted, their layout must not change");
+
+		//!
+		//! A shard file.
+		//!
+		struct Shard
+		{
+			//! Read-only handle, used for positioned reads
+			QFile * File = nullptr;
+
+			//! Number of bytes used by records referenced by the index
+			uint64_t Live = 0;
+
+			//! Number of bytes used by records which were replaced
+			uint64_t Dead = 0;
+		};
+
+		// private API
+		static uint64_t	RecordSize(uint32_t length);
+		QString			GetShardPath(uint32_t id) const;
+		bool			LoadIndex(const QVector< uint32_t > & shards);
+		bool			MapIndex(uint32_t capacity, bool clear);
+		void			UnmapIndex(bool clean);
+		const Entry *	Find(uint64_t key) const;
+		Entry *			Find(uint64_t key);
+		Entry *			Insert(uint64_t key);
+		void			Remove(uint64_t key);
+		bool			LoadShard(uint32_t id);
+		bool			AddShard(uint32_t id);
+		bool			OpenWriter(uint32_t id);
+		bool			Append(Header header, const QByteArray & data, uint32_t & shard, uint64_t & offset);
+		bool			Read(const Entry & entry, QByteArray & data) const;
+		uint64_t		GetLiveSize(void) const;
+		bool			NeedsEviction(void) const;
+		void			ScheduleMaintenance(void);
+		void			Evict(void);
+		void			Compact(void);
+
+		//! Folder containing the shards
+		QString m_Path;
+
+		//! The index file
+		QFile m_IndexFile;
+
+		//! The mapped header of the index
+		IndexHeader * m_Header;
+
+		//! The mapped entries of the index
+		Entry * m_Entries;
+
+		//! The shards
+		QHash< uint32_t, Shard > m_Shards;
+
+		//! Protects the index and the shards
+		mutable QReadWriteLock m_Lock;
+
+		//! Serializes the appends to the active shard. Must be locked before m_Lock
+		QMutex m_WriteMutex;
+
+		//! Handle used to append records to the active shard
+		QFile m_Writer;
+
+		//! Identifier of the active shard
+		uint32_t m_Active;
+
+		//! Current size of the active shard
+		uint64_t m_ActiveSize;
+
+		//! Size after which a new shard is started
+		uint64_t m_MaxShardSize;
+
+		//! Maximum number of bytes used by the live records, 0 for no limit
+		std::atomic< uint64_t > m_Budget;
+
+		//! True while a maintenance (eviction and compaction) is scheduled or running
+		std::atomic_bool m_Maintaining;
+
+		//! Pool used to run the maintenance
+		QThreadPool m_Pool;
+
+	};
+
+}
@@ -0,0 +1,349 @@
+#include "ViewerProvider.h"
+
+#include "CppUtils/MemoryTracker.h"
+#include "Downscale.h"
+#include "EmbeddedPreview.h"
+#include "ImageResponse.h"
+#include "JpegDecoder.h"
+#include "ThumbnailCache.h"
+#include "Models/Media.h"
+#include "QtUtils/Settings.h"
+#include "Utils/Job.h"
+
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QScreen>
+#include <QThread>
+
+
+namespace MediaViewer
+{
+
+	//! Priority of the images requested by the viewer, over the prefetched ones
+	static constexpr int RequestPriority = 1;
+
+	//! Maximum number of medias prefetched on each side of the current one
+	static constexpr int MaxPrefetchCount = 16;
+
+	//!
+	//! Constructor
+	//!
+	ViewerProvider::ViewerProvider(void)
+		: m_PrefetchCount(qBound(0, Settings::Get< int >("ViewerProvider.PrefetchCount"), MaxPrefetchCount))
+		, m_Index(-1)
+		, m_Forward(true)
+	{
+		// decode at the physical resolution of the screen
+		const QScreen * screen = QGuiApplication::primaryScreen();
+		if (screen != nullptr)
+		{
+			m_ScreenSize = screen->size() * screen->devicePixelRatio();
+		}
+
+		m_Images.SetBudget(static_cast< uint64_t >(qMax(Settings::Get< int >("ViewerProvider.CacheSize"), 0)) * 1024 * 1024);
+
+		// keep a thread free for the user interface
+		m_Pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+	}
+
+	//!
+	//! Destructor
+	//!
+	ViewerProvider::~ViewerProvider(void)
+	{
+		{
+			QMutexLocker lock(&m_Mutex);
+			m_Wanted.clear();
+			for (std::atomic_bool * cancel : qAsConst(m_Decoding))
+			{
+				*cancel = true;
+			}
+		}
+		m_Pool.clear();
+		m_Pool.waitForDone();
+
+		// responses still owned by the engine must not call us back
+		QMutexLocker lock(&m_Mutex);
+		for (ImageResponse * response : qAsConst(m_Waiting))
+		{
+			response->SetDestroyedCallback(nullptr);
+		}
+		for (ImageResponse * response : qAsConst(m_Finished))
+		{
+			response->SetDestroyedCallback(nullptr);
+		}
+	}
+
+	//!
+	//! Get the key of an image in the cache
+	//!
+	static uint64_t GetKey(const QString & path, const QSize & size)
+	{
+		return ThumbnailCache::GetKey(path, size.width(), size.height());
+	}
+
+	//!
+	//! Get an image for the given id, which is the path of the image. The requested size is
+	//! ignored, images are always decoded at the screen resolution.
+	//!
+	QQuickImageResponse * ViewerProvider::requestImageResponse(const QString & id, const QSize & /* requestedSize */)
+	{
+		const QString path = id;
+		const uint64_t key = GetKey(path, m_ScreenSize);
+
+		// prefetched, and the image didn't change since
+		ThumbnailCache::Source source;
+		QImage cached;
+		if (ThumbnailCache::GetSource(path, source) == true && m_Images.Get(key, source, cached) == true)
+		{
+			return MT_NEW ImageResponse(cached);
+		}
+
+		// being prefetched: instead of decoding it twice, the prefetch finishes the response. It
+		// can't be cancelled anymore, since the viewer needs it
+		{
+			QMutexLocker lock(&m_Mutex);
+			const auto decoding = m_Decoding.constFind(path);
+			if (decoding != m_Decoding.constEnd())
+			{
+				*decoding.value() = false;
+				ImageResponse * response = MT_NEW ImageResponse();
+				m_Waiting.insert(path, response);
+				response->SetDestroyedCallback([this, path] (ImageResponse * destroyed) {
+					QMutexLocker lock(&m_Mutex);
+					m_Waiting.remove(path, destroyed);
+					m_Finished.remove(destroyed);
+				});
+				return response;
+			}
+		}
+
+		return MT_NEW ImageResponse([=] (std::atomic_bool & cancel) -> QImage {
+			ThumbnailCache::Source source;
+			QImage image;
+			if (cancel == true || ThumbnailCache::GetSource(path, source) == false || m_Images.Get(key, source, image) == true)
+			{
+				return image;
+			}
+
+			image = this->Decode(path, cancel);
+			if (cancel == false)
+			{
+				m_Images.Put(key, source, image);
+			}
+			return image;
+		}, &m_Pool, RequestPriority);
+	}
+
+	//!
+	//! Get the number of medias prefetched on each side of the current one
+	//!
+	int ViewerProvider::GetPrefetchCount(void) const
+	{
+		return m_PrefetchCount;
+	}
+
+	//!
+	//! Set the number of medias prefetched on each side of the current one
+	//!
+	void ViewerProvider::SetPrefetchCount(int count)
+	{
+		count = qBound(0, count, MaxPrefetchCount);
+		if (m_PrefetchCount != count)
+		{
+			m_PrefetchCount = count;
+			Settings::Set("ViewerProvider.PrefetchCount", count);
+			emit prefetchCountChanged(count);
+		}
+	}
+
+	//!
+	//! Get the maximum size of the decoded images, in MB
+	//!
+	int ViewerProvider::GetCacheSize(void) const
+	{
+		return static_cast< int >(m_Images.GetBudget() / (1024 * 1024));
+	}
+
+	//!
+	//! Set the maximum size of the decoded images, in MB
+	//!
+	void ViewerProvider::SetCacheSize(int size)
+	{
+		size = qMax(size, 0);
+		if (this->GetCacheSize() != size)
+		{
+			m_Images.SetBudget(static_cast< uint64_t >(size) * 1024 * 1024);
+			Settings::Set("ViewerProvider.CacheSize", size);
+			emit cacheSizeChanged(size);
+		}
+	}
+
+	//!
+	//! Notify the provider that the viewer shows another media, and prefetch its neighbors.
+	//!
+	//! Moving to the next or previous media keeps or changes the navigation direction, and the
+	//! medias in that direction are prefetched first. Anything else is a jump: the direction is
+	//! kept, and the prefetches of medias which are not around the new one are dropped, or
+	//! cancelled if they're being decoded.
+	//!
+	//! @param index
+	//!		Index of the current media in the model.
+	//!
+	//! @param paths
+	//!		Paths of the medias around the current one, in the model order.
+	//!
+	//! @param first
+	//!		Index in the model of the first path.
+	//!
+	void ViewerProvider::navigate(int index, const QStringList & paths, int first)
+	{
+		const int step = index - m_Index;
+		if (m_Index != -1 && qAbs(step) == 1)
+		{
+			m_Forward = step > 0;
+		}
+		m_Index = index;
+
+		// the medias to prefetch, by decreasing priority: ahead first, then behind
+		QStringList prefetch;
+		for (bool ahead : { true, false })
+		{
+			const int direction = ahead == m_Forward ? 1 : -1;
+			for (int i = 1; i <= m_PrefetchCount; ++i)
+			{
+				const int position = index + direction * i - first;
+				if (position >= 0 && position < paths.size() && Media::GetType(paths[position]) == Media::Type::Image)
+				{
+					prefetch.push_back(paths[position]);
+				}
+			}
+		}
+
+		QMutexLocker lock(&m_Mutex);
+		m_Wanted.clear();
+		if (index - first >= 0 && index - first < paths.size())
+		{
+			m_Wanted.insert(paths[index - first]);
+		}
+		for (const QString & path : qAsConst(prefetch))
+		{
+			m_Wanted.insert(path);
+		}
+
+		// cancel the prefetches which are not needed anymore, and resume the ones needed again
+		for (auto decoding = m_Decoding.begin(); decoding != m_Decoding.end(); ++decoding)
+		{
+			*decoding.value() = m_Wanted.contains(decoding.key()) == false && m_Waiting.contains(decoding.key()) == false;
+		}
+
+		for (const QString & path : qAsConst(prefetch))
+		{
+			// whether it's already decoded is checked by the prefetch, to avoid querying the files here
+			if (m_Queued.contains(path) == true || m_Decoding.contains(path) == true)
+			{
+				continue;
+			}
+			m_Queued.insert(path);
+			MT_NEW Job([this, path] (void) { this->Prefetch(path); }, &m_Pool);
+		}
+	}
+
+	//!
+	//! Prefetch an image, if it's still needed. The decoding is cancelled by navigate when the user
+	//! jumps away from the image.
+	//!
+	void ViewerProvider::Prefetch(const QString & path)
+	{
+		std::atomic_bool cancel(false);
+		{
+			QMutexLocker lock(&m_Mutex);
+			m_Queued.remove(path);
+			if (m_Wanted.contains(path) == false)
+			{
+				return;
+			}
+			m_Decoding.insert(path, &cancel);
+		}
+
+		const uint64_t key = GetKey(path, m_ScreenSize);
+		ThumbnailCache::Source source;
+		QImage image;
+		const bool decode = ThumbnailCache::GetSource(path, source) == true && m_Images.Get(key, source, image) == false;
+		for (bool done = false; done == false;)
+		{
+			bool cancelled = false;
+			if (decode == true)
+			{
+				image = this->Decode(path, cancel);
+				cancelled = cancel;
+				if (cancelled == false)
+				{
+					m_Images.Put(key, source, image);
+				}
+			}
+
+			// the user might have come back to the image after the decoding was cancelled
+			QMutexLocker lock(&m_Mutex);
+			done = cancelled == false || cancel == true;
+			if (done == true)
+			{
+				// finish the requests which were waiting for it
+				m_Decoding.remove(path);
+				for (ImageResponse * response : m_Waiting.values(path))
+				{
+					m_Finished.insert(response);
+					response->Finish(image);
+				}
+				m_Waiting.remove(path);
+			}
+		}
+	}
+
+	//!
+	//! Decode an image so that it fits the screen. Images smaller than the screen keep their size.
+	//!
+	QImage ViewerProvider::Decode(const QString & path, std::atomic_bool & cancel) const
+	{
+		QImageReader reader(path);
+		reader.setAutoTransform(true);
+		if (cancel == true || reader.canRead() == false)
+		{
+			return QImage();
+		}
+
+		// the screen size, in the orientation of the stored image
+		const QSize imageSize = reader.size();
+		const QSize screenSize = (reader.transformation() & QImageIOHandler::TransformationRotate90) != 0 ? m_ScreenSize.transposed() : m_ScreenSize;
+		if (imageSize.isValid() == false || m_ScreenSize.isValid() == false || (imageSize.width() <= screenSize.width() && imageSize.height() <= screenSize.height()))
+		{
+			return reader.read();
+		}
+		const QSize scaledSize = imageSize.scaled(screenSize, Qt::KeepAspectRatio);
+
+		// JPEG images can be decoded directly at a fraction of their size
+		if (reader.format() == "jpeg")
+		{
+			const QImage image = DecodeJpeg(path, scaledSize);
+			if (image.isNull() == false)
+			{
+				return ApplyOrientation(image, GetExifOrientation(path));
+			}
+		}
+
+		// let the reader scale if it can do it while decoding, otherwise use our downscaler
+		if (reader.supportsOption(QImageIOHandler::ScaledSize) == true)
+		{
+			reader.setScaledSize(scaledSize);
+			return cancel == false ? reader.read() : QImage();
+		}
+		const QImage image = cancel == false ? reader.read() : QImage();
+		if (cancel == true || image.isNull() == true)
+		{
+			return QImage();
+		}
+		return Downscale(image, image.size() == imageSize ? scaledSize : scaledSize.transposed());
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ImageCache.h"
+
+#include <QHash>
+#include <QMultiHash>
+#include <QMutex>
+#include <QObject>
+#include <QQuickAsyncImageProvider>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+#include <atomic>
+
+
+namespace MediaViewer
+{
+
+	class ImageResponse;
+
+
+	//!
+	//! Image provider used by the full screen image viewer.
+	//!
+	//! Images are decoded at the resolution of the screen instead of their own, and kept in a size
+	//! bounded cache. The viewer reports each navigation with navigate(), and the images around the
+	//! current one are decoded ahead on background threads, starting with the ones in the direction
+	//! the user is going. When the user jumps to another media, the prefetches which are not needed
+	//! anymore are dropped if they were not started yet, and cancelled otherwise. An image requested
+	//! while it's being prefetched is given to the viewer by the prefetch.
+	//!
+	class ViewerProvider
+		: public QObject
+		, public QQuickAsyncImageProvider
+	{
+
+		Q_OBJECT
+
+		Q_PROPERTY(int prefetchCount READ GetPrefetchCount WRITE SetPrefetchCount NOTIFY prefetchCountChanged)
+		Q_PROPERTY(int cacheSize READ GetCacheSize WRITE SetCacheSize NOTIFY cacheSizeChanged)
+
+	signals:
+
+		void	prefetchCountChanged(int prefetchCount);
+		void	cacheSizeChanged(int cacheSize);
+
+	public:
+
+		ViewerProvider(void);
+		~ViewerProvider(void);
+
+		// reimplemented from QQuickAsyncImageProvider
+		QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) final;
+
+		// public C++ API
+		int		GetPrefetchCount(void) const;
+		void	SetPrefetchCount(int count);
+		int		GetCacheSize(void) const;
+		void	SetCacheSize(int size);
+
+		// public QML API
+		Q_INVOKABLE void	navigate(int index, const QStringList & paths, int first);
+
+	private:
+
+		// private API
+		QImage	Decode(const QString & path, std::atomic_bool & cancel) const;
+		void	Prefetch(const QString & path);
+
+		//! The size the images are decoded at
+		QSize m_ScreenSize;
+
+		//! The number of medias prefetched on each side of the current one
+		int m_PrefetchCount;
+
+		//! The decoded images
+		ImageCache m_Images;
+
+		//! Pool decoding the images
+		QThreadPool m_Pool;
+
+		//! Index of the current media, -1 before the first navigation
+		int m_Index;
+
+		//! True when the user is navigating towards the end of the medias
+		bool m_Forward;
+
+		//! The medias which can be prefetched. Prefetches of other medias are dropped
+		QSet< QString > m_Wanted;
+
+		//! The medias which are waiting to be prefetched
+		QSet< QString > m_Queued;
+
+		//! The medias being prefetched, with the flag cancelling their decoding
+		QHash< QString, std::atomic_bool * > m_Decoding;
+
+		//! The responses waiting for a prefetch, by path
+		QMultiHash< QString, ImageResponse * > m_Waiting;
+
+		//! The responses finished by a prefetch, tracked until they're destroyed
+		QSet< ImageResponse * > m_Finished;
+
+		//! Protects m_Wanted, m_Queued, m_Decoding, m_Waiting and m_Finished
+		mutable QMutex m_Mutex;
+
+	};
+
+}
@@ -1,5 +1,7 @@
+#include "ImageProviders/CacheWarmer.h"
 #include "ImageProviders/FolderIconProvider.h"
 #include "ImageProviders/MediaPreviewProvider.h"
+#include "ImageProviders/ViewerProvider.h"
 #include "QtUtils/QuickView.h"
 #include "QtUtils/Settings.h"
 #include "RegisterQMLTypes.h"
@@ -7,10 +9,12 @@
 #include "Utils/FileSystem.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QQmlContext>
 #include <QQuickStyle>
 #include <QDir>
 #include <QStandardPaths>
+#include <QThread>
 
 // header-only libs implementations
 #define MEMORY_TRACKER_IMPLEMENTATION
@@ -89,18 +93,10 @@ QVariantList GetRootDrives(void)
 }
 
 //!
-//! Set the application engine with our main QML file
+//! Create the settings and their default values
 //!
-void Setup(QApplication & app, QuickView & view)
+void InitSettings(void)
 {
-	view.setDefaultAlphaBuffer(true);
-	view.setColor(Qt::transparent);
-
-	// register QML types
-	MediaViewer::RegisterQMLTypes();
-
-	// the settings. These need to be created first since some other parts of the
-	// code will check them to initialize correctly
 	settings = MT_NEW Settings;
 	settings->Init("FileSystem.DeletePermanently",			false);
 	settings->Init("General.RestoreLastVisitedFolder",		true);
@@ -109,6 +105,7 @@ void Setup(QApplication & app, QuickView & view)
 	settings->Init("Media.SortOrder",						0);
 	settings->Init("Media.ThumbnailSize",					200);
 	settings->Init("Media.ShowLabel",						true);
+	settings->Init("Media.ScrubFrames",						10);
 	settings->Init("Slideshow.Loop",						true);
 	settings->Init("Slideshow.Selection",					true);
 	settings->Init("Slideshow.Delay",						2000);
@@ -117,10 +114,33 @@ void Setup(QApplication & app, QuickView & view)
 	settings->Init("Movie.Muted",							true);
 	settings->Init("Movie.Volume",							0.5);
 	settings->Init("MediaPreviewProvider.UseCache",			true);
+	settings->Init("MediaPreviewProvider.CacheSize",		2048);
+	settings->Init("MediaPreviewProvider.MemoryCacheSize",	256);
+	settings->Init("MediaPreviewProvider.MoviePosition",	10);
+	settings->Init("MediaPreviewProvider.MovieCandidates",	1);
 	settings->Init("MediaPreviewProvider.CachePath",		MediaViewer::MediaPreviewProvider::DefaultCachePath());
+	settings->Init("ViewerProvider.PrefetchCount",			3);
+	settings->Init("ViewerProvider.CacheSize",				512);
+}
+
+//!
+//! Set the application engine with our main QML file
+//!
+void Setup(QApplication & app, QuickView & view)
+{
+	view.setDefaultAlphaBuffer(true);
+	view.setColor(Qt::transparent);
+
+	// register QML types
+	MediaViewer::RegisterQMLTypes();
+
+	// the settings. These need to be created first since some other parts of the
+	// code will check them to initialize correctly
+	InitSettings();
 
 	// create data that's shared with QML
 	auto * mediaProvider	= MT_NEW MediaViewer::MediaPreviewProvider;
+	auto * viewerProvider	= MT_NEW MediaViewer::ViewerProvider;
 	cursor					= MT_NEW Cursor;
 	fileSystem				= MT_NEW FileSystem;
 
@@ -128,6 +148,7 @@ void Setup(QApplication & app, QuickView & view)
 	QQmlEngine & engine = *view.engine();
 	engine.addImageProvider("FolderIcon", MT_NEW MediaViewer::FolderIconProvider);
 	engine.addImageProvider("MediaPreview", mediaProvider);
+	engine.addImageProvider("Viewer", viewerProvider);
 
 	// set a few global QML helpers
 	engine.rootContext()->setContextProperties({
@@ -135,6 +156,7 @@ void Setup(QApplication & app, QuickView & view)
 		{ "cursor",			QVariant::fromValue(cursor) },
 		{ "fileSystem",		QVariant::fromValue(fileSystem) },
 		{ "mediaProvider",	QVariant::fromValue(mediaProvider) },
+		{ "viewerProvider",	QVariant::fromValue(viewerProvider) },
 		{ "rootView",		QVariant::fromValue(&view) },
 		{ "drives",			GetRootDrives() },
 	});
@@ -177,11 +199,102 @@ void Setup(QApplication & app, QuickView & view)
 	view.requestActivate();
 }
 
+//!
+//! Add the options of the headless mode to a command line parser
+//!
+void AddWarmCacheOptions(QCommandLineParser & parser)
+{
+	parser.addOptions({
+		{ "warm-cache",	"Folder containing the medias.",									"dir" },
+		{ "recursive",	"Also process the sub folders." },
+		{ "sizes",		"Comma separated thumbnail sizes (defaults to the current one).",	"sizes" },
+		{ "jobs",		"Number of previews generated in parallel (defaults to the cores).",	"count" },
+	});
+}
+
+//!
+//! Check if we were launched to generate previews without showing any window. The command line is
+//! parsed with the options of the headless mode, so that every form the parser accepts is detected
+//! (--warm-cache dir, --warm-cache=dir, etc.)
+//!
+bool IsHeadless(int argc, char *argv[])
+{
+	QStringList arguments;
+	for (int i = 0; i < argc; ++i)
+	{
+		arguments << QString::fromLocal8Bit(argv[i]);
+	}
+
+	// the options of the GUI application are unknown here, which is not an error
+	QCommandLineParser parser;
+	AddWarmCacheOptions(parser);
+	parser.parse(arguments);
+	return parser.isSet("warm-cache");
+}
+
+//!
+//! Headless entry point: generate the previews of a folder so that browsing it later only hits the
+//! cache. This doesn't need a display, so it can be run from a scheduled task.
+//!
+int WarmCache(int argc, char *argv[])
+{
+	int code = -1;
+	{
+		// no GUI application, previews don't need it
+		QCoreApplication app(argc, argv);
+		app.setOrganizationName(ORGANIZATION_NAME);
+		app.setApplicationName(APPLICATION_NAME);
+		app.setApplicationVersion(APPLICATION_VERSION);
+		qInstallMessageHandler(MessageHandler);
+
+		// parse the command line
+		QCommandLineParser parser;
+		parser.setApplicationDescription("Generate the previews of a folder.");
+		parser.addHelpOption();
+		AddWarmCacheOptions(parser);
+		parser.process(app);
+
+		// the provider reads its configuration from the settings
+		InitSettings();
+
+		MediaViewer::CacheWarmerOptions options;
+		options.Folder		= QFileInfo(parser.value("warm-cache")).absoluteFilePath();
+		options.Recursive	= parser.isSet("recursive");
+		options.Jobs		= parser.isSet("jobs") ? parser.value("jobs").toInt() : QThread::idealThreadCount();
+		options.ScrubFrames	= Settings::Get< int >("Media.ScrubFrames");
+		for (const QString & size : parser.value("sizes").split(',', Qt::SkipEmptyParts))
+		{
+			if (size.toInt() > 20)
+			{
+				options.Sizes << size.toInt();
+			}
+		}
+		if (options.Sizes.isEmpty() == true)
+		{
+			options.Sizes << Settings::Get< int >("Media.ThumbnailSize");
+		}
+
+		// generate
+		auto * mediaProvider = MT_NEW MediaViewer::MediaPreviewProvider;
+		code = MediaViewer::WarmCache(*mediaProvider, options);
+		MT_DELETE mediaProvider;
+	}
+
+	MT_DELETE settings;
+	MT_SHUTDOWN(qDebug);
+	return code;
+}
+
 //!
 //! Entry point of the application
 //!
 int main(int argc, char *argv[])
 {
+	if (IsHeadless(argc, argv) == true)
+	{
+		return WarmCache(argc, argv);
+	}
+
 	int code = -1;
 	{
 		// create the application
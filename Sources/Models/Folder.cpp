@@ -3,10 +3,13 @@
 #include "CppUtils/MemoryTracker.h"
 #include "Folder.h"
 #include "Media.h"
+#include "Utils/DirectoryScanner.h"
 #include "Utils/Job.h"
 
 #include <QDir>
 
+#include <algorithm>
+
 
 namespace MediaViewer
 {
@@ -116,12 +119,17 @@ namespace MediaViewer
 		if (m_Dirty == true)
 		{
 			// initialize the list of children
-			QDir dir(m_Path);
-			if (dir.exists() == true)
+			const DirectoryScanner scanner(m_Path);
+			if (scanner.IsValid() == true)
 			{
-				for (const auto & child : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
+				QVector< DirectoryScanner::Entry > children = scanner.List(DirectoryScanner::Directories);
+				std::sort(children.begin(), children.end(), [] (const DirectoryScanner::Entry & left, const DirectoryScanner::Entry & right) {
+					return left.Name < right.Name;
+				});
+				const QDir dir(m_Path);
+				for (const DirectoryScanner::Entry & child : children)
 				{
-					m_Children.push_back(MT_NEW Folder(dir.absoluteFilePath(child.filePath()), this));
+					m_Children.push_back(MT_NEW Folder(dir.absoluteFilePath(child.Name), this));
 				}
 			}
 
@@ -139,17 +147,11 @@ namespace MediaViewer
 			// reset the media count
 			m_MediaCount = 0;
 
-			// initialize the list of children, and count medias
-			QDir dir(m_Path);
-			if (dir.exists() == true)
+			// count medias. Only their names are needed, so the files are not queried
+			const DirectoryScanner scanner(m_Path);
+			if (scanner.IsValid() == true)
 			{
-				for (const auto & child : dir.entryInfoList(QDir::Files, QDir::NoSort))
-				{
-					if (Media::IsMedia(child.fileName()))
-					{
-						++m_MediaCount;
-					}
-				}
+				m_MediaCount = scanner.List(DirectoryScanner::Files, Media::IsMedia).size();
 			}
 
 			// notify
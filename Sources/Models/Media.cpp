@@ -40,14 +40,26 @@ namespace MediaViewer
 	//!
 	Media::Media(const QString & path)
 		: m_Path(path)
-		, m_Name(QFileInfo(path).fileName())
 		, m_Type(GetType(path))
 	{
-		QFileInfo info(path);
+		const QFileInfo info(path);
+		m_Name	= info.fileName();
 		m_Date	= info.lastModified();
 		m_Size	= info.size();
 	}
 
+	//!
+	//! Constructor for a media whose information are already known, which avoids querying the file.
+	//!
+	Media::Media(const QString & path, const QString & name, uint64_t size, const QDateTime & date)
+		: m_Path(path)
+		, m_Name(name)
+		, m_Date(date)
+		, m_Size(size)
+		, m_Type(GetType(name))
+	{
+	}
+
 	//!
 	//! Copy constructor
 	//!
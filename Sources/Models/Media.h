@@ -54,6 +54,7 @@ namespace MediaViewer
 	public:
 
 		Media(const QString & path = "");
+		Media(const QString & path, const QString & name, uint64_t size, const QDateTime & date);
 		Media(const Media & other);
 		~Media(void);
 
@@ -2,26 +2,58 @@
 
 #include "Media.h"
 #include "CppUtils/MemoryTracker.h"
-#include "CppUtils/STLUtils.h"
+#include "Utils/DirectoryScanner.h"
+#include "Utils/Job.h"
+#include "Utils/ParallelSort.h"
 
 #include <QDir>
+#include <QElapsedTimer>
 #include <QQmlEngine>
+#include <QSet>
+
+#include <algorithm>
 
 
 namespace MediaViewer
 {
 
+	//! Minimum number of medias published to the model at once while loading. Batches then grow with
+	//! the number of medias already published, so that merging them stays linear overall
+	static constexpr int BatchSize = 512;
+
+	//! Maximum number of milliseconds between 2 batches while loading
+	static constexpr int BatchInterval = 100;
+
+	//! Maximum number of ranges inserted one by one by InsertMedias. Above, the medias are merged
+	static constexpr int MaxInsertedRanges = 8;
+
+	//! Maximum number of selected medias for which an exclusive selection looks for the medias to
+	//! unselect in the selection, instead of walking all the rows
+	static constexpr int MaxSparseSelection = 256;
+
 	//!
 	//! Constructor.
 	//!
 	MediaModel::MediaModel(QObject * parent)
 		: QAbstractItemModel(parent)
-		, m_Dirty(false)
+		, m_ValidIndices(0)
+		, m_SelectedCount(0)
+		, m_Current(-1)
+		, m_CurrentIndex(-1)
 		, m_SortBy(SortBy::None)
 		, m_SortOrder(SortOrder::Ascending)
+		, m_Loading(false)
+		, m_Progress(0.0)
+		, m_Rescan(false)
 	{
 		// setup file watching
 		QObject::connect(&m_FileWatcher, &QFileSystemWatcher::directoryChanged, this, &MediaModel::UpdateMedias);
+
+		// the current media is tracked by identifier, its row is updated whenever rows move
+		QObject::connect(this, &QAbstractItemModel::rowsInserted, this, &MediaModel::UpdateCurrentIndex);
+		QObject::connect(this, &QAbstractItemModel::rowsRemoved, this, &MediaModel::UpdateCurrentIndex);
+		QObject::connect(this, &QAbstractItemModel::layoutChanged, this, &MediaModel::UpdateCurrentIndex);
+		QObject::connect(this, &QAbstractItemModel::modelReset, this, &MediaModel::UpdateCurrentIndex);
 	}
 
 	//!
@@ -29,7 +61,9 @@ namespace MediaViewer
 	//!
 	MediaModel::~MediaModel(void)
 	{
+		// stop the enumeration. Its pending batches are discarded with this object
 		this->Clear();
+		m_Pool.waitForDone();
 	}
 
 	//!
@@ -52,6 +86,11 @@ namespace MediaViewer
 		this->beginResetModel();
 		this->Clear();
 		m_Root = path;
+		m_Prefix = QDir(path).absolutePath();
+		if (m_Prefix.endsWith('/') == false)
+		{
+			m_Prefix += '/';
+		}
 		this->endResetModel();
 
 		// add the new path to the file watcher
@@ -59,138 +98,393 @@ namespace MediaViewer
 
 		// notify
 		emit rootChanged(m_Root);
+
+		// and start loading the medias
+		this->Load();
 	}
 
 	//!
-	//! Clear the medias
+	//! Clear the medias, and cancel the enumeration if it's still running
 	//!
 	void MediaModel::Clear(void)
 	{
+		if (m_Cancel)
+		{
+			*m_Cancel = true;
+			m_Cancel.reset();
+		}
 		for (Media * media : m_Medias)
 		{
 			MT_DELETE media;
 		}
 		m_Medias.clear();
-		m_Dirty = true;
+		m_Rows.clear();
+		this->ClearPermutations();
+		this->InvalidateIndices(0);
+		m_Selection.clear();
+		if (m_SelectedCount != 0)
+		{
+			m_SelectedCount = 0;
+			emit selectedCountChanged(0);
+		}
+		m_Current = -1;
+		m_Store.Clear();
+		this->SetLoading(false);
 	}
 
 	//!
-	//! Update the medias after a folder change
+	//! Enumerate the medias of the root folder on a worker thread.
 	//!
-	void MediaModel::UpdateMedias(const QString & folder)
+	//! The names are listed first, which is cheap even on network shares, to know how many medias
+	//! there are. Then the medias are queried and published to the model in batches, as they
+	//! arrive. Only the directory entries cross threads, the model stores them itself.
+	//!
+	void MediaModel::Load(void)
 	{
-		Q_UNUSED(folder);
+		auto cancel = std::make_shared< std::atomic_bool >(false);
+		m_Cancel = cancel;
+		m_Rescan = false;
+		this->SetProgress(0.0);
+		this->SetLoading(true);
 
-		// rescan the folder
-		QDir root(m_Root);
-		QVector< QString > medias;
-		for (const auto & file : root.entryList(QDir::Files, QDir::NoSort))
-		{
-			if (Media::IsMedia(file) == true)
+		const QString root = m_Root;
+		MT_NEW Job([this, root, cancel] (void) {
+			// publish a batch on the model's thread
+			auto publish = [this, cancel] (const QVector< DirectoryScanner::Entry > & batch, double progress, bool done) {
+				QMetaObject::invokeMethod(this, [this, batch, cancel, progress, done] (void) {
+					this->AddBatch(batch, cancel, progress, done);
+				}, Qt::QueuedConnection);
+			};
+
+			// list the medias
+			const DirectoryScanner scanner(root);
+			QVector< DirectoryScanner::Entry > entries = scanner.List(DirectoryScanner::Files, Media::IsMedia);
+
+			// query them
+			QVector< DirectoryScanner::Entry > batch;
+			int published = 0;
+			QElapsedTimer timer;
+			timer.start();
+			for (int i = 0; i < entries.size(); ++i)
 			{
-				medias.push_back(file);
+				if (*cancel == true)
+				{
+					return;
+				}
+
+				DirectoryScanner::Entry & entry = entries[i];
+				if (scanner.Stat(entry) == true)
+				{
+					batch.push_back(entry);
+				}
+
+				if (batch.size() >= qMax(BatchSize, published) || timer.elapsed() >= BatchInterval)
+				{
+					publish(batch, (i + 1) / double(entries.size()), false);
+					published += batch.size();
+					batch.clear();
+					timer.restart();
+				}
 			}
+			publish(batch, 1.0, true);
+		}, &m_Pool);
+	}
+
+	//!
+	//! Add a batch of medias sent by the enumeration
+	//!
+	//! @param entries
+	//!		The stated directory entries of the medias.
+	//!
+	//! @param cancel
+	//!		Cancellation flag of the enumeration which sent them.
+	//!
+	//! @param progress
+	//!		Fraction of the medias which were loaded.
+	//!
+	//! @param done
+	//!		True for the last batch.
+	//!
+	void MediaModel::AddBatch(const QVector< DirectoryScanner::Entry > & entries, const std::shared_ptr< std::atomic_bool > & cancel, double progress, bool done)
+	{
+		// a stale batch, from a previous root
+		if (*cancel == true)
+		{
+			return;
 		}
 
-		// check deleted images
-		int index = 0;
-		QVector< int > toRemove;
-		for (const Media * media : m_Medias)
+		QVector< int > ids;
+		ids.reserve(entries.size());
+		for (const DirectoryScanner::Entry & entry : entries)
 		{
-			if (medias.contains(media->GetName()) == false)
-			{
-				toRemove.push_back(index);
-			}
-			++index;
+			ids.push_back(m_Store.Add(entry.Name, static_cast< uint64_t >(entry.Size), entry.Date));
 		}
+		this->InsertMedias(ids);
+		this->SetProgress(progress);
 
-		// check added images
-		QVector< QString > toAdd;
-		for (const QString & file : medias)
+		if (done == true)
 		{
-			bool found = false;
-			for (const Media * media : m_Medias)
+			m_Cancel.reset();
+			this->SetLoading(false);
+
+			// the folder changed while we were loading it
+			if (m_Rescan == true)
 			{
-				if (media->GetName() == file)
-				{
-					found = true;
-					break;
-				}
+				m_Rescan = false;
+				this->UpdateMedias(m_Root);
 			}
-			if (found == false)
+		}
+	}
+
+	//!
+	//! Get the value compared first when sorting by something else than the name. Dates are
+	//! offset so that they compare as unsigned values.
+	//!
+	static inline uint64_t GetSortValue(const MediaStore & store, MediaModel::SortBy by, int id)
+	{
+		switch (by)
+		{
+			case MediaModel::SortBy::Date:	return static_cast< uint64_t >(store.GetDate(id)) ^ (uint64_t(1) << 63);
+			case MediaModel::SortBy::Size:	return store.GetSize(id);
+			case MediaModel::SortBy::Type:	return static_cast< uint64_t >(store.GetType(id));
+			default:						return 0;
+		}
+	}
+
+	//!
+	//! Get the sort operator. It compares identifiers of medias in m_Store, in ascending order, and
+	//! is used to insert medias in m_Rows, so it must give the same order as Sort: ties are broken
+	//! by the rank of the names, so the ranks must be up to date. It's a plain lambda comparing
+	//! integers, so that it can be inlined in the sorts and searches using it.
+	//!
+	auto MediaModel::GetSortOperator(void) const
+	{
+		const MediaStore * store = &m_Store;
+		const SortBy by = m_SortBy;
+		return [store, by] (int l, int r) -> bool {
+			if (by == SortBy::None)
 			{
-				toAdd.push_back(file);
+				return false;
 			}
+			const uint64_t left = GetSortValue(*store, by, l);
+			const uint64_t right = GetSortValue(*store, by, r);
+			return left < right || (left == right && store->GetRank(l) < store->GetRank(r));
+		};
+	}
+
+	//!
+	//! Insert medias in the model.
+	//!
+	//! They're sorted and their insertion points are found with a binary search. Consecutive medias
+	//! with the same insertion point are inserted in one go, so the views get one notification per
+	//! range instead of one per media. Each range moves the end of the rows though, so when there
+	//! are many ranges (typically while loading a folder) the medias are instead appended, and
+	//! merged with the rows in a single pass, which the views see as a layout change.
+	//!
+	//! @param ids
+	//!		Identifiers of the medias in m_Store.
+	//!
+	void MediaModel::InsertMedias(QVector< int > & ids)
+	{
+		if (ids.isEmpty() == true)
+		{
+			return;
 		}
 
-		// remove
-		while (toRemove.isEmpty() == false)
+		this->ClearPermutations();
+		if (m_Selection.size() < m_Store.GetCapacity())
 		{
-			index = toRemove.back();
-			this->beginRemoveRows(QModelIndex(), index, index);
-			MT_DELETE m_Medias[index];
-			m_Medias.remove(index);
-			this->endRemoveRows();
-			toRemove.pop_back();
+			m_Selection.resize(m_Store.GetCapacity());
+		}
+		if (m_SortBy != SortBy::None)
+		{
+			m_Store.UpdateRanks();
 		}
+		const auto sort = this->GetSortOperator();
+		std::stable_sort(ids.begin(), ids.end(), sort);
 
-		// add
-		auto sort = this->GetSortOperator();
-		for (const QString & file : toAdd)
+		// since they're sorted, their insertion points are increasing. Each range is the first
+		// media of the range and its insertion point in the current rows
+		QVector< QPair< int, int > > ranges;
+		for (int start = 0; start < ids.size() && ranges.size() <= MaxInsertedRanges;)
 		{
-			Media * media = MT_NEW Media(root.absoluteFilePath(file));
-			index = 0;
-			for (Media * m : m_Medias)
+			const int index = static_cast< int >(std::upper_bound(m_Rows.begin(), m_Rows.end(), ids[start], sort) - m_Rows.begin());
+			ranges.push_back({ start, index });
+			int end = start + 1;
+			while (end < ids.size() && (index == m_Rows.size() || sort(ids[end], m_Rows[index]) == true))
 			{
-				bool res = sort(media, m);
-				if (res == false)
-				{
-					++index;
-				}
-				else
-				{
-					this->beginInsertRows(QModelIndex(), index, index);
-					m_Medias.insert(index, media);
-					this->endInsertRows();
-					index = -1;
-					break;
-				}
+				++end;
 			}
+			start = end;
+		}
 
-			// if we reach here, push back
-			if (index != -1)
-			{
-				this->beginInsertRows(QModelIndex(), index, index);
-				m_Medias.push_back(media);
-				this->endInsertRows();
-			}
+		if (ranges.size() > MaxInsertedRanges)
+		{
+			const int count = m_Rows.size();
+			const int row = m_SortOrder == SortOrder::Ascending ? count : 0;
+			this->beginInsertRows(QModelIndex(), row, row + ids.size() - 1);
+			this->InvalidateIndices(count);
+			m_Rows += ids;
+			this->endInsertRows();
+
+			// new medias go after the existing ones they're equivalent to, like with upper_bound
+			this->ChangeLayout([&] (void) {
+				std::inplace_merge(m_Rows.begin(), m_Rows.begin() + count, m_Rows.end(), sort);
+				this->InvalidateIndices(ranges.front().second);
+			});
+			return;
+		}
+
+		for (int i = 0; i < ranges.size(); ++i)
+		{
+			// the previous ranges moved the insertion point
+			const int start = ranges[i].first;
+			const int end = i + 1 < ranges.size() ? ranges[i + 1].first : ids.size();
+			const int index = ranges[i].second + start;
+			const int row = m_SortOrder == SortOrder::Ascending ? index : m_Rows.size() - index;
+			this->beginInsertRows(QModelIndex(), row, row + end - start - 1);
+			this->InvalidateIndices(index);
+			m_Rows.insert(index, end - start, -1);
+			std::copy(ids.begin() + start, ids.begin() + end, m_Rows.begin() + index);
+			this->endInsertRows();
+		}
+	}
+
+	//!
+	//! Remove a media from the store, unselect it, and delete its Media object if it was created
+	//!
+	void MediaModel::RemoveMedia(int id)
+	{
+		// identifiers are reused, so the current media must be forgotten
+		if (m_Current == id)
+		{
+			m_Current = -1;
+		}
+		if (m_Selection.testBit(id) == true)
+		{
+			m_Selection.clearBit(id);
+			--m_SelectedCount;
+		}
+		auto media = m_Medias.find(id);
+		if (media != m_Medias.end())
+		{
+			MT_DELETE media.value();
+			m_Medias.erase(media);
+		}
+		m_Store.Remove(id);
+	}
+
+	//!
+	//! Get the path of a media
+	//!
+	QString MediaModel::GetPath(int id) const
+	{
+		const QStringView name = m_Store.GetName(id);
+		QString path;
+		path.reserve(m_Prefix.size() + name.size());
+		path.append(m_Prefix);
+		path.append(name.data(), name.size());
+		return path;
+	}
+
+	//!
+	//! Update the loading state
+	//!
+	void MediaModel::SetLoading(bool loading)
+	{
+		if (m_Loading != loading)
+		{
+			m_Loading = loading;
+			emit loadingChanged(loading);
+		}
+	}
+
+	//!
+	//! Update the loading progress
+	//!
+	void MediaModel::SetProgress(double progress)
+	{
+		if (m_Progress != progress)
+		{
+			m_Progress = progress;
+			emit progressChanged(progress);
 		}
 	}
 
 	//!
-	//! Get the medias in the root folder
+	//! Update the medias after a folder change.
 	//!
-	const QVector< Media * > &	MediaModel::GetMedias(void) const
+	//! The folder is rescanned and diffed against the current medias by name. Removed medias are
+	//! removed by contiguous ranges, so the views get one notification per range instead of one
+	//! per file, and new medias are inserted with InsertMedias.
+	//!
+	void MediaModel::UpdateMedias(const QString & folder)
 	{
-		if (m_Dirty == true)
+		Q_UNUSED(folder);
+
+		// still loading, rescan once it's done
+		if (m_Loading == true)
+		{
+			m_Rescan = true;
+			return;
+		}
+
+		// rescan the folder
+		const DirectoryScanner scanner(m_Root);
+		QHash< QString, DirectoryScanner::Entry > files;
+		for (const DirectoryScanner::Entry & entry : scanner.List(DirectoryScanner::Files, Media::IsMedia))
+		{
+			files.insert(entry.Name, entry);
+		}
+
+		// remove the medias which are not there anymore, starting from the end of m_Rows so that
+		// the indices of the next ranges are still valid
+		const int selected = m_SelectedCount;
+		auto exists = [&] (int index) {
+			return files.contains(m_Store.GetName(m_Rows[index]).toString());
+		};
+		QSet< QString > existing;
+		existing.reserve(m_Rows.size());
+		for (int last = m_Rows.size() - 1; last >= 0; --last)
 		{
-			QDir dir(m_Root);
-			for (const auto & file : dir.entryList(QDir::Files, QDir::NoSort))
+			if (exists(last) == true)
 			{
-				if (Media::IsMedia(file) == true)
-				{
-					m_Medias.push_back(MT_NEW Media(dir.absoluteFilePath(file)));
-					QQmlEngine::setObjectOwnership(m_Medias.back(), QQmlEngine::CppOwnership);
-				}
+				existing.insert(m_Store.GetName(m_Rows[last]).toString());
+				continue;
+			}
+			int first = last;
+			while (first > 0 && exists(first - 1) == false)
+			{
+				--first;
 			}
+			this->ClearPermutations();
+			const int firstRow = this->GetRowIndex(m_SortOrder == SortOrder::Ascending ? first : last);
+			this->beginRemoveRows(QModelIndex(), firstRow, firstRow + last - first);
+			for (int i = first; i <= last; ++i)
+			{
+				this->RemoveMedia(m_Rows[i]);
+			}
+			m_Rows.remove(first, last - first + 1);
+			this->InvalidateIndices(first);
+			this->endRemoveRows();
+			last = first;
+		}
 
-			// sort
-			this->Sort();
+		if (m_SelectedCount != selected)
+		{
+			emit selectedCountChanged(m_SelectedCount);
+		}
 
-			// reset the dirty flag
-			m_Dirty = false;
+		// add the new medias
+		QVector< int > added;
+		for (auto file = files.begin(); file != files.end(); ++file)
+		{
+			if (existing.contains(file.key()) == false && scanner.Stat(file.value()) == true)
+			{
+				added.push_back(m_Store.Add(file.key(), static_cast< uint64_t >(file->Size), file->Date));
+			}
 		}
-		return m_Medias;
+		this->InsertMedias(added);
 	}
 
 	//!
@@ -217,79 +511,159 @@ namespace MediaViewer
 		}
 	}
 
-#define SORT_FUNCTOR	\
-	std::function< bool (const Media *, const Media *) >([](const Media * l, const Media * r) -> bool
-
 	//!
-	//! Get the sort operator
+	//! Sort the model.
 	//!
-	std::function< bool (const Media *, const Media *) > MediaModel::GetSortOperator(void) const
+	//! A key is computed once per media: the sorted value and the rank of the name, or only the rank
+	//! when sorting by name. The keys are then sorted with a parallel stable sort comparing plain
+	//! integers, so no collation nor indirect call happens during the sort. m_Rows is always sorted
+	//! in ascending order, the descending order is a reversed view of it.
+	//!
+	void MediaModel::Sort(void)
 	{
-		switch (m_SortBy)
+		if (m_SortBy == SortBy::None)
 		{
-			case SortBy::Name:
-				return m_SortOrder == SortOrder::Ascending ?
-					SORT_FUNCTOR { return l->GetName() < r->GetName(); }) :
-					SORT_FUNCTOR { return l->GetName() > r->GetName(); });
+			return;
+		}
 
-			case SortBy::Date:
-				return m_SortOrder == SortOrder::Ascending ?
-					SORT_FUNCTOR { return l->GetDate() < r->GetDate(); }) :
-					SORT_FUNCTOR { return l->GetDate() > r->GetDate(); });
+		//! Sort key of a media
+		struct Key
+		{
+			uint64_t Value;
+			uint32_t Rank;
+			int Id;
+		};
 
-			case SortBy::Size:
-				return m_SortOrder == SortOrder::Ascending ?
-					SORT_FUNCTOR { return l->GetSize() < r->GetSize(); }) :
-					SORT_FUNCTOR { return l->GetSize() > r->GetSize(); });
+		m_Store.UpdateRanks();
+		QVector< Key > keys;
+		keys.reserve(m_Rows.size());
+		for (int id : m_Rows)
+		{
+			Key key = { GetSortValue(m_Store, m_SortBy, id), m_Store.GetRank(id), id };
+			if (m_SortBy == SortBy::Name)
+			{
+				key.Value = key.Rank;
+				key.Rank = 0;
+			}
+			keys.push_back(key);
+		}
 
-			case SortBy::Type:
-				return m_SortOrder == SortOrder::Ascending ?
-					SORT_FUNCTOR { return l->GetType() < r->GetType(); }) :
-					SORT_FUNCTOR { return l->GetType() > r->GetType(); });
+		ParallelStableSort(keys.data(), keys.size(), [] (const Key & l, const Key & r) {
+			return l.Value < r.Value || (l.Value == r.Value && l.Rank < r.Rank);
+		});
 
-			default:
-				return SORT_FUNCTOR {
-					Q_UNUSED(l);
-					Q_UNUSED(r);
-					return false;
-				});
+		for (int i = 0; i < keys.size(); ++i)
+		{
+			m_Rows[i] = keys[i].Id;
 		}
+		this->InvalidateIndices(0);
 	}
 
-#undef SORT_FUNCTOR
+	//!
+	//! The QML invokable sort method
+	//!
+	void MediaModel::sort(SortBy by, SortOrder order)
+	{
+		if (m_SortBy == by && m_SortOrder == order)
+		{
+			return;
+		}
 
+		const bool byChanged = m_SortBy != by;
+		const bool orderChanged = m_SortOrder != order;
+		this->ChangeLayout([&] (void) {
+			if (byChanged == true)
+			{
+				// keep the current permutation, and reuse the one of the new sort if it's still valid
+				if (m_SortBy != SortBy::None)
+				{
+					m_Permutations[static_cast< int >(m_SortBy)] = m_Rows;
+				}
+				m_SortBy = by;
+				if (by != SortBy::None)
+				{
+					QVector< int > & permutation = m_Permutations[static_cast< int >(by)];
+					if (permutation.size() == m_Rows.size())
+					{
+						m_Rows = permutation;
+						this->InvalidateIndices(0);
+					}
+					else
+					{
+						this->Sort();
+						permutation = m_Rows;
+					}
+				}
+			}
+			m_SortOrder = order;
+		});
+
+		if (byChanged == true)
+		{
+			emit sortByChanged(by);
+		}
+		if (orderChanged == true)
+		{
+			emit sortOrderChanged(order);
+		}
+	}
+
+	//!
+	//! Change the order of the rows, without resetting the model.
 	//!
-	//! Sort the model
+	//! Persistent indices (the views' delegates, the selection, etc.) are moved to the new rows of
+	//! their medias, so they survive the change.
 	//!
-	void MediaModel::Sort(void) const
+	//! @param change
+	//!		Function changing the order of the rows.
+	//!
+	void MediaModel::ChangeLayout(const std::function< void (void) > & change)
 	{
-		::Sort(m_Medias, this->GetSortOperator());
+		emit layoutAboutToBeChanged(QList< QPersistentModelIndex >(), QAbstractItemModel::VerticalSortHint);
+
+		const QModelIndexList from = this->persistentIndexList();
+		change();
+
+		if (from.isEmpty() == false)
+		{
+			QModelIndexList to;
+			to.reserve(from.size());
+			for (const QModelIndex & index : from)
+			{
+				const int row = this->GetRowIndex(this->GetIndexOf(static_cast< int >(index.internalId())));
+				to.push_back(this->createIndex(row, index.column(), index.internalId()));
+			}
+			this->changePersistentIndexList(from, to);
+		}
+
+		emit layoutChanged(QList< QPersistentModelIndex >(), QAbstractItemModel::VerticalSortHint);
 	}
 
 	//!
-	//! The QML invokable sort method
+	//! Get the index in m_Rows of a media. The indices which are not valid anymore are updated
+	//! first, so this is constant time unless medias moved since the last call.
 	//!
-	void MediaModel::sort(SortBy by, SortOrder order)
+	int MediaModel::GetIndexOf(int id) const
 	{
-		bool needSort = false;
-		if (m_SortBy != by)
+		if (m_Indices.size() < m_Store.GetCapacity())
 		{
-			needSort = true;
-			m_SortBy = by;
-			emit sortByChanged(by);
+			m_Indices.resize(m_Store.GetCapacity());
 		}
-		if (m_SortOrder != order)
+		for (; m_ValidIndices < m_Rows.size(); ++m_ValidIndices)
 		{
-			needSort = true;
-			m_SortOrder = order;
-			emit sortOrderChanged(order);
+			m_Indices[m_Rows[m_ValidIndices]] = m_ValidIndices;
 		}
+		return m_Indices[id];
+	}
 
-		if (needSort == true)
+	//!
+	//! Drop the cached permutations, when medias are added or removed
+	//!
+	void MediaModel::ClearPermutations(void)
+	{
+		for (QVector< int > & permutation : m_Permutations)
 		{
-			this->beginResetModel();
-			this->Sort();
-			this->endResetModel();
+			permutation.clear();
 		}
 	}
 
@@ -298,16 +672,12 @@ namespace MediaViewer
 	//!
 	int MediaModel::getIndexByPath(const QString & path) const
 	{
-		int index = 0;
-		for (const Media * media : this->GetMedias())
+		if (path.startsWith(m_Prefix) == false)
 		{
-			if (media->GetPath() == path)
-			{
-				return index;
-			}
-			++index;
+			return -1;
 		}
-		return -1;
+		const int id = m_Store.Find(QStringView(path).mid(m_Prefix.size()));
+		return id != -1 ? this->GetRowIndex(this->GetIndexOf(id)) : -1;
 	}
 
 	//!
@@ -316,7 +686,7 @@ namespace MediaViewer
 	QModelIndex MediaModel::getModelIndexByPath(const QString & path) const
 	{
 		int index = this->getIndexByPath(path);
-		return index != -1 ? this->createIndex(index, 0, const_cast< Media * >(this->GetMedias()[index])) : QModelIndex();
+		return index != -1 ? this->index(index, 0) : QModelIndex();
 	}
 
 	//!
@@ -324,9 +694,8 @@ namespace MediaViewer
 	//!
 	QModelIndex MediaModel::getPreviousModelIndex(const QModelIndex & index) const
 	{
-		Q_ASSERT(index.isValid() == true && index.row() >= 0 && index.row() < this->GetMedias().size());
-		int newIndex = qMax(index.row() - 1, 0);
-		return this->createIndex(newIndex, 0, this->GetMedias()[newIndex]);
+		Q_ASSERT(index.isValid() == true && index.row() >= 0 && index.row() < m_Rows.size());
+		return this->index(qMax(index.row() - 1, 0), 0);
 	}
 
 	//!
@@ -334,9 +703,8 @@ namespace MediaViewer
 	//!
 	QModelIndex MediaModel::getNextModelIndex(const QModelIndex & index) const
 	{
-		Q_ASSERT(index.isValid() == true && index.row() >= 0 && index.row() < this->GetMedias().size());
-		int newIndex = qMin(index.row() + 1, this->GetMedias().size() - 1);
-		return this->createIndex(newIndex, 0, this->GetMedias()[newIndex]);
+		Q_ASSERT(index.isValid() == true && index.row() >= 0 && index.row() < m_Rows.size());
+		return this->index(qMin(index.row() + 1, m_Rows.size() - 1), 0);
 	}
 
 	//!
@@ -344,15 +712,33 @@ namespace MediaViewer
 	//!
 	QModelIndex MediaModel::getModelIndexByIndex(int index) const
 	{
-		return (index >= 0 && index < this->GetMedias().size()) ? this->createIndex(index, 0, this->GetMedias()[index]) : QModelIndex();
+		return (index >= 0 && index < m_Rows.size()) ? this->index(index, 0) : QModelIndex();
 	}
 
 	//!
-	//! Get a media
+	//! Get a media. The Media object is created on the first call, and owned by the model until
+	//! the media is removed.
 	//!
 	Media * MediaModel::getMedia(const QModelIndex & index) const
 	{
-		return index.isValid() == true ? static_cast< Media * >(index.internalPointer()) : nullptr;
+		if (index.isValid() == false)
+		{
+			return nullptr;
+		}
+
+		const int id = static_cast< int >(index.internalId());
+		Media *& media = m_Medias[id];
+		if (media == nullptr)
+		{
+			media = MT_NEW Media(
+				this->GetPath(id),
+				m_Store.GetName(id).toString(),
+				m_Store.GetSize(id),
+				QDateTime::fromMSecsSinceEpoch(m_Store.GetDate(id))
+			);
+			QQmlEngine::setObjectOwnership(media, QQmlEngine::CppOwnership);
+		}
+		return media;
 	}
 
 	//!
@@ -363,6 +749,235 @@ namespace MediaViewer
 		return index.isValid() == true ? index.row() : -1;
 	}
 
+	//!
+	//! Get the paths of the medias in the given range of indices (inclusive). The range is clamped
+	//! to the valid indices.
+	//!
+	QStringList MediaModel::getPaths(int first, int last) const
+	{
+		first = qMax(first, 0);
+		last = qMin(last, m_Rows.size() - 1);
+		QStringList paths;
+		paths.reserve(qMax(last - first + 1, 0));
+		for (int i = first; i <= last; ++i)
+		{
+			paths.push_back(this->GetPath(m_Rows[this->GetRowIndex(i)]));
+		}
+		return paths;
+	}
+
+	//!
+	//! Change the selection state of the medias in a range of rows (inclusive).
+	//!
+	//! The selection is a bit per media identifier, so it follows the medias when they're sorted.
+	//! The views are notified once per contiguous range of rows which actually changed.
+	//!
+	void MediaModel::UpdateSelection(int first, int last, Selection selection)
+	{
+		first = qMax(first, 0);
+		last = qMin(last, m_Rows.size() - 1);
+		if (first > last || (selection == Selection::Unselect && m_SelectedCount == 0))
+		{
+			return;
+		}
+
+		const int count = m_SelectedCount;
+		int start = -1;
+		for (int row = first; row <= last + 1; ++row)
+		{
+			bool changed = false;
+			if (row <= last)
+			{
+				const int id = m_Rows[this->GetRowIndex(row)];
+				const bool selected = m_Selection.testBit(id);
+				const bool state = selection == Selection::Toggle ? selected == false : selection == Selection::Select;
+				if (state != selected)
+				{
+					m_Selection.toggleBit(id);
+					m_SelectedCount += selected == true ? -1 : 1;
+					changed = true;
+				}
+			}
+
+			if (changed == true && start == -1)
+			{
+				start = row;
+			}
+			else if (changed == false && start != -1)
+			{
+				emit dataChanged(this->index(start, 0), this->index(row - 1, 0), { Qt::UserRole + 4 });
+				start = -1;
+			}
+		}
+
+		if (m_SelectedCount != count)
+		{
+			emit selectedCountChanged(m_SelectedCount);
+		}
+	}
+
+	//!
+	//! Set the current media
+	//!
+	//! @param index
+	//!		Row of the media, or -1 to clear the current media.
+	//!
+	void MediaModel::SetCurrentIndex(int index)
+	{
+		m_Current = index >= 0 && index < m_Rows.size() ? m_Rows[this->GetRowIndex(index)] : -1;
+		this->UpdateCurrentIndex();
+	}
+
+	//!
+	//! Update the row of the current media, after rows were inserted, removed or moved
+	//!
+	void MediaModel::UpdateCurrentIndex(void)
+	{
+		const int index = m_Current != -1 ? this->GetRowIndex(this->GetIndexOf(m_Current)) : -1;
+		if (index != m_CurrentIndex)
+		{
+			m_CurrentIndex = index;
+			emit currentIndexChanged(index);
+		}
+	}
+
+	//!
+	//! Check if a media is selected
+	//!
+	bool MediaModel::isSelected(int index) const
+	{
+		return index >= 0 && index < m_Rows.size() ? m_Selection.testBit(m_Rows[this->GetRowIndex(index)]) : false;
+	}
+
+	//!
+	//! Select a range of medias (inclusive).
+	//!
+	//! @param exclusive
+	//!		If true, the medias outside of the range are unselected. When only a few medias are
+	//!		selected (the usual case when the current media changes) they're found in the selection
+	//!		and unselected one by one, instead of walking all the rows.
+	//!
+	void MediaModel::select(int first, int last, bool exclusive)
+	{
+		if (exclusive == true && m_SelectedCount > MaxSparseSelection)
+		{
+			this->UpdateSelection(0, first - 1, Selection::Unselect);
+			this->UpdateSelection(last + 1, m_Rows.size() - 1, Selection::Unselect);
+		}
+		else if (exclusive == true && m_SelectedCount != 0)
+		{
+			// skip bytes with no selected media, and stop once all the selected medias are found
+			QVector< int > rows;
+			int found = 0;
+			const uchar * bits = reinterpret_cast< const uchar * >(m_Selection.bits());
+			for (int id = 0; found < m_SelectedCount && id < m_Selection.size(); ++id)
+			{
+				if (bits[id >> 3] == 0)
+				{
+					id |= 7;
+				}
+				else if (m_Selection.testBit(id) == true)
+				{
+					++found;
+					const int row = this->GetRowIndex(this->GetIndexOf(id));
+					if (row < first || row > last)
+					{
+						rows.push_back(row);
+					}
+				}
+			}
+
+			std::sort(rows.begin(), rows.end());
+			for (int i = 0; i < rows.size();)
+			{
+				int end = i + 1;
+				while (end < rows.size() && rows[end] == rows[end - 1] + 1)
+				{
+					++end;
+				}
+				this->UpdateSelection(rows[i], rows[end - 1], Selection::Unselect);
+				i = end;
+			}
+		}
+		this->UpdateSelection(first, last, Selection::Select);
+	}
+
+	//!
+	//! Unselect a range of medias (inclusive)
+	//!
+	void MediaModel::unselect(int first, int last)
+	{
+		this->UpdateSelection(first, last, Selection::Unselect);
+	}
+
+	//!
+	//! Toggle the selection of a media
+	//!
+	void MediaModel::toggleSelection(int index)
+	{
+		this->UpdateSelection(index, index, Selection::Toggle);
+	}
+
+	//!
+	//! Select all the medias
+	//!
+	void MediaModel::selectAll(void)
+	{
+		this->UpdateSelection(0, m_Rows.size() - 1, Selection::Select);
+	}
+
+	//!
+	//! Inverse the selection
+	//!
+	void MediaModel::selectInverse(void)
+	{
+		this->UpdateSelection(0, m_Rows.size() - 1, Selection::Toggle);
+	}
+
+	//!
+	//! Unselect all the medias
+	//!
+	void MediaModel::clearSelection(void)
+	{
+		this->UpdateSelection(0, m_Rows.size() - 1, Selection::Unselect);
+	}
+
+	//!
+	//! Get the first selected media
+	//!
+	//! @return
+	//!		The index of the media, or -1 if nothing is selected.
+	//!
+	int MediaModel::getFirstSelected(void) const
+	{
+		for (int row = 0; m_SelectedCount != 0 && row < m_Rows.size(); ++row)
+		{
+			if (m_Selection.testBit(m_Rows[this->GetRowIndex(row)]) == true)
+			{
+				return row;
+			}
+		}
+		return -1;
+	}
+
+	//!
+	//! Get the paths of the selected medias, in the order of the model
+	//!
+	QStringList MediaModel::getSelectedPaths(void) const
+	{
+		QStringList paths;
+		paths.reserve(m_SelectedCount);
+		for (int row = 0; paths.size() < m_SelectedCount && row < m_Rows.size(); ++row)
+		{
+			const int id = m_Rows[this->GetRowIndex(row)];
+			if (m_Selection.testBit(id) == true)
+			{
+				paths.push_back(this->GetPath(id));
+			}
+		}
+		return paths;
+	}
+
 	//!
 	//! Get the roles supported by this model
 	//!
@@ -373,7 +988,8 @@ namespace MediaViewer
 			{ Qt::UserRole,		"path" },
 			{ Qt::UserRole + 1,	"date" },
 			{ Qt::UserRole + 2,	"size" },
-			{ Qt::UserRole + 3,	"type" }
+			{ Qt::UserRole + 3,	"type" },
+			{ Qt::UserRole + 4,	"selected" }
 		};
 	}
 
@@ -387,16 +1003,15 @@ namespace MediaViewer
 			return QVariant();
 		}
 
-		Media * media = static_cast< Media * >(index.internalPointer());
-		Q_ASSERT(media != nullptr);
-
+		const int id = static_cast< int >(index.internalId());
 		switch (role)
 		{
-			case Qt::DisplayRole:	return media->GetName();
-			case Qt::UserRole:		return media->GetPath();
-			case Qt::UserRole + 1:	return media->GetDate();
-			case Qt::UserRole + 2:	return static_cast< qulonglong >(media->GetSize());
-			case Qt::UserRole + 3:	return static_cast< int >(media->GetType());
+			case Qt::DisplayRole:	return m_Store.GetName(id).toString();
+			case Qt::UserRole:		return this->GetPath(id);
+			case Qt::UserRole + 1:	return QDateTime::fromMSecsSinceEpoch(m_Store.GetDate(id));
+			case Qt::UserRole + 2:	return static_cast< qulonglong >(m_Store.GetSize(id));
+			case Qt::UserRole + 3:	return static_cast< int >(m_Store.GetType(id));
+			case Qt::UserRole + 4:	return m_Selection.testBit(id);
 			default:				return QVariant();
 		}
 	}
@@ -411,7 +1026,7 @@ namespace MediaViewer
 	{
 		Q_UNUSED(parent);
 		Q_ASSERT(parent.isValid() == false);
-		return this->createIndex(row, column, this->GetMedias().at(row));
+		return this->createIndex(row, column, static_cast< quintptr >(m_Rows.at(this->GetRowIndex(row))));
 	}
 
 	//!
@@ -427,7 +1042,7 @@ namespace MediaViewer
 	//!
 	int MediaModel::rowCount(const QModelIndex & parent) const
 	{
-		return parent.isValid() == true ? 0 : this->GetMedias().size();
+		return parent.isValid() == true ? 0 : m_Rows.size();
 	}
 
 	//!
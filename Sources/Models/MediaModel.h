@@ -1,7 +1,15 @@
 #pragma once
 
+#include "MediaStore.h"
+#include "Utils/DirectoryScanner.h"
+
 #include <QAbstractItemModel>
+#include <QBitArray>
 #include <QFileSystemWatcher>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
 
 
 namespace MediaViewer
@@ -24,6 +32,10 @@ namespace MediaViewer
 		Q_PROPERTY(QString root READ GetRoot WRITE SetRoot NOTIFY rootChanged)
 		Q_PROPERTY(SortBy sortBy READ GetSortBy WRITE SetSortBy NOTIFY sortByChanged)
 		Q_PROPERTY(SortOrder sortOrder READ GetSortOrder WRITE SetSortOrder NOTIFY sortOrderChanged)
+		Q_PROPERTY(bool loading READ IsLoading NOTIFY loadingChanged)
+		Q_PROPERTY(double progress READ GetProgress NOTIFY progressChanged)
+		Q_PROPERTY(int selectedCount READ GetSelectedCount NOTIFY selectedCountChanged)
+		Q_PROPERTY(int currentIndex READ GetCurrentIndex WRITE SetCurrentIndex NOTIFY currentIndexChanged)
 
 	public:
 
@@ -49,6 +61,10 @@ namespace MediaViewer
 		void	rootChanged(const QString & path);
 		void	sortByChanged(SortBy sortBy);
 		void	sortOrderChanged(SortOrder sortOrder);
+		void	loadingChanged(bool loading);
+		void	progressChanged(double progress);
+		void	selectedCountChanged(int count);
+		void	currentIndexChanged(int index);
 
 	public:
 
@@ -66,12 +82,16 @@ namespace MediaViewer
 		// public API
 		inline const QString &		GetRoot(void) const;
 		void						SetRoot(const QString & path);
-		const QVector< Media * > &	GetMedias(void) const;
 		inline SortBy				GetSortBy(void) const;
 		void						SetSortBy(SortBy by);
 		inline SortOrder			GetSortOrder(void) const;
 		void						SetSortOrder(SortOrder order);
-		void						Sort(void) const;
+		inline bool					IsLoading(void) const;
+		inline double				GetProgress(void) const;
+		inline int					GetSelectedCount(void) const;
+		inline int					GetCurrentIndex(void) const;
+		void						SetCurrentIndex(int index);
+		void						Sort(void);
 
 		// needed to silence warnings on hidden functions
 		using QAbstractItemModel::sort;
@@ -84,24 +104,84 @@ namespace MediaViewer
 		Q_INVOKABLE QModelIndex		getModelIndexByIndex(int index) const;
 		Q_INVOKABLE Media *			getMedia(const QModelIndex & index) const;
 		Q_INVOKABLE int				getIndex(const QModelIndex & index) const;
+		Q_INVOKABLE QStringList		getPaths(int first, int last) const;
 		Q_INVOKABLE void			sort(SortBy by, SortOrder order);
+		Q_INVOKABLE bool			isSelected(int index) const;
+		Q_INVOKABLE void			select(int first, int last, bool exclusive);
+		Q_INVOKABLE void			unselect(int first, int last);
+		Q_INVOKABLE void			toggleSelection(int index);
+		Q_INVOKABLE void			selectAll(void);
+		Q_INVOKABLE void			selectInverse(void);
+		Q_INVOKABLE void			clearSelection(void);
+		Q_INVOKABLE int				getFirstSelected(void) const;
+		Q_INVOKABLE QStringList		getSelectedPaths(void) const;
 
 	private:
 
+		//! The ways to change the selection state of the medias
+		enum class Selection
+		{
+			Select,
+			Unselect,
+			Toggle
+		};
+
 		void	Clear(void);
+		void	Load(void);
+		void	AddBatch(const QVector< DirectoryScanner::Entry > & entries, const std::shared_ptr< std::atomic_bool > & cancel, double progress, bool done);
+		void	InsertMedias(QVector< int > & ids);
+		void	RemoveMedia(int id);
 		void	UpdateMedias(const QString & folder);
-
-		//! todo: replace hugly std::function by auto when c++14 is supported
-		std::function< bool (const Media *, const Media *) > GetSortOperator(void) const;
+		QString	GetPath(int id) const;
+		void	UpdateSelection(int first, int last, Selection selection);
+		void	UpdateCurrentIndex(void);
+		void	SetLoading(bool loading);
+		void	SetProgress(double progress);
+		void	ChangeLayout(const std::function< void (void) > & change);
+		void	ClearPermutations(void);
+		int		GetIndexOf(int id) const;
+		inline void	InvalidateIndices(int index);
+		inline int	GetRowIndex(int row) const;
+		auto	GetSortOperator(void) const;
 
 		//! The root folder
 		QString m_Root;
 
-		//! Dirty flag
-		mutable bool m_Dirty;
+		//! Absolute path of the root folder, with a trailing separator
+		QString m_Prefix;
+
+		//! The medias in the root folder
+		MediaStore m_Store;
+
+		//! Identifiers in m_Store of the medias, sorted in ascending order. In descending order, the
+		//! rows are read from the end (see GetRowIndex)
+		mutable QVector< int > m_Rows;
+
+		//! Cached ascending orders of m_Rows, for each sort type. They're dropped when medias are
+		//! added or removed
+		QVector< int > m_Permutations[static_cast< int >(SortBy::None)];
+
+		//! Index in m_Rows of each media, by identifier. Only valid for the indices lower than
+		//! m_ValidIndices, the others are updated on demand
+		mutable QVector< int > m_Indices;
 
-		//! The media in the root folder
-		mutable QVector< Media * > m_Medias;
+		//! Number of valid indices at the start of m_Rows in m_Indices
+		mutable int m_ValidIndices;
+
+		//! Selection state of each media, by identifier
+		QBitArray m_Selection;
+
+		//! Number of selected medias
+		int m_SelectedCount;
+
+		//! Identifier of the current media, -1 if there's none
+		int m_Current;
+
+		//! Row of the current media. Updated when rows move, so that it follows the media
+		int m_CurrentIndex;
+
+		//! Media objects created for QML by getMedia, by identifier
+		mutable QHash< int, Media * > m_Medias;
 
 		//! The sort criteria
 		SortBy m_SortBy;
@@ -112,6 +192,21 @@ namespace MediaViewer
 		//! File watcher used to detect file changes in the current folder
 		QFileSystemWatcher m_FileWatcher;
 
+		//! True while the medias of the root folder are being enumerated
+		bool m_Loading;
+
+		//! Fraction of the medias of the root folder which were loaded
+		double m_Progress;
+
+		//! Set when the folder changed while loading, it's rescanned once loaded
+		bool m_Rescan;
+
+		//! Cancellation flag of the current enumeration
+		std::shared_ptr< std::atomic_bool > m_Cancel;
+
+		//! Pool running the enumerations
+		QThreadPool m_Pool;
+
 	};
 
 }
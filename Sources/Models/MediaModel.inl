@@ -28,4 +28,54 @@ namespace MediaViewer
 		return m_SortOrder;
 	}
 
+	//!
+	//! Check if the medias are being loaded
+	//!
+	inline bool MediaModel::IsLoading(void) const
+	{
+		return m_Loading;
+	}
+
+	//!
+	//! Get the fraction of the medias which were loaded, between 0 and 1
+	//!
+	inline double MediaModel::GetProgress(void) const
+	{
+		return m_Progress;
+	}
+
+	//!
+	//! Get the number of selected medias
+	//!
+	inline int MediaModel::GetSelectedCount(void) const
+	{
+		return m_SelectedCount;
+	}
+
+	//!
+	//! Get the row of the current media, -1 if there's none
+	//!
+	inline int MediaModel::GetCurrentIndex(void) const
+	{
+		return m_CurrentIndex;
+	}
+
+	//!
+	//! Get the index in m_Rows of a row. The descending order is a reversed view of m_Rows, so
+	//! this also converts an index of m_Rows back to its row.
+	//!
+	inline int MediaModel::GetRowIndex(int row) const
+	{
+		return m_SortOrder == SortOrder::Ascending ? row : m_Rows.size() - 1 - row;
+	}
+
+	//!
+	//! Invalidate the indices of the medias from an index of m_Rows, when the medias from there
+	//! moved
+	//!
+	inline void MediaModel::InvalidateIndices(int index)
+	{
+		m_ValidIndices = qMin(m_ValidIndices, index);
+	}
+
 }
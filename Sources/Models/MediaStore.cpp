@@ -0,0 +1,237 @@
+#include "MediaStore.h"
+#include "Utils/ParallelSort.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+
+namespace MediaViewer
+{
+
+	//! Rank of the medias added since the last update of the ranks
+	static constexpr uint32_t Unranked = std::numeric_limits< uint32_t >::max();
+
+	//!
+	//! Constructor.
+	//!
+	MediaStore::MediaStore(void)
+		: m_RemovedCharacters(0)
+	{
+		m_Collator.setNumericMode(true);
+	}
+
+	//!
+	//! Add a media.
+	//!
+	//! @return
+	//!		The identifier of the media.
+	//!
+	int MediaStore::Add(const QString & name, uint64_t size, int64_t date)
+	{
+		int id = m_Types.size();
+		if (m_Free.isEmpty() == false)
+		{
+			id = m_Free.takeLast();
+		}
+		else
+		{
+			m_NameOffsets.push_back(0);
+			m_NameLengths.push_back(0);
+			m_Sizes.push_back(0);
+			m_Dates.push_back(0);
+			m_Types.push_back(0);
+			m_Ranks.push_back(0);
+		}
+
+		m_NameOffsets[id]	= static_cast< uint32_t >(m_Names.size());
+		m_NameLengths[id]	= static_cast< uint32_t >(name.size());
+		m_Sizes[id]			= size;
+		m_Dates[id]			= date;
+		m_Types[id]			= static_cast< uint8_t >(Media::GetType(name));
+		m_Names += name;
+		m_Ids.insert(qHash(QStringView(name)), id);
+
+		// an identifier removed and reused before the ranks are updated is already pending
+		if (m_Ranks[id] != Unranked)
+		{
+			m_Ranks[id] = Unranked;
+			m_Unranked.push_back(id);
+		}
+		return id;
+	}
+
+	//!
+	//! Remove a media. Its identifier might be reused by the next added media.
+	//!
+	void MediaStore::Remove(int id)
+	{
+		m_Ids.remove(qHash(this->GetName(id)), id);
+		m_RemovedCharacters += static_cast< int >(m_NameLengths[id]);
+		m_NameLengths[id] = 0;
+		m_Types[id] = static_cast< uint8_t >(Media::Type::NotSupported);
+		m_Free.push_back(id);
+
+		if (m_RemovedCharacters > m_Names.size() / 2)
+		{
+			this->Compact();
+		}
+	}
+
+	//!
+	//! Remove all the medias
+	//!
+	void MediaStore::Clear(void)
+	{
+		m_Names.clear();
+		m_NameOffsets.clear();
+		m_NameLengths.clear();
+		m_Sizes.clear();
+		m_Dates.clear();
+		m_Types.clear();
+		m_Ranks.clear();
+		m_Ranked.clear();
+		m_Unranked.clear();
+		m_Ids.clear();
+		m_Free.clear();
+		m_RemovedCharacters = 0;
+	}
+
+	//!
+	//! Update the ranks of the names, if medias were added since the last update.
+	//!
+	//! Only the added names are sorted, using collation keys which are faster to compare than the
+	//! names, and released once the ranks are computed. They're then merged with the names already
+	//! ranked, with a binary search per added name, and the ranks are reassigned in a single pass.
+	//!
+	//! Removing medias leaves gaps in the ranks, but doesn't change their order, so it doesn't
+	//! invalidate them.
+	//!
+	void MediaStore::UpdateRanks(void)
+	{
+		if (m_Unranked.isEmpty() == true)
+		{
+			return;
+		}
+
+		// drop the removed medias, and the ones whose identifier was reused by an added media
+		const uint8_t removed = static_cast< uint8_t >(Media::Type::NotSupported);
+		QVector< int > ranked;
+		ranked.reserve(this->GetCount());
+		for (int id : qAsConst(m_Ranked))
+		{
+			if (m_Types[id] != removed && m_Ranks[id] != Unranked)
+			{
+				ranked.push_back(id);
+			}
+		}
+
+		// the added medias which were removed since are simply forgotten
+		QVector< int > added;
+		added.reserve(m_Unranked.size());
+		for (int id : qAsConst(m_Unranked))
+		{
+			if (m_Types[id] != removed)
+			{
+				added.push_back(id);
+			}
+			else
+			{
+				m_Ranks[id] = 0;
+			}
+		}
+		m_Unranked.clear();
+
+		// sort the added medias
+		std::vector< QCollatorSortKey > keys;
+		keys.reserve(added.size());
+		for (int id : qAsConst(added))
+		{
+			keys.push_back(m_Collator.sortKey(this->GetName(id).toString()));
+		}
+		QVector< int > order(added.size());
+		std::iota(order.begin(), order.end(), 0);
+		ParallelStableSort(order.data(), order.size(), [&keys] (int left, int right) {
+			return keys[left].compare(keys[right]) < 0;
+		});
+		keys.clear();
+
+		// merge them with the ranked ones and reassign the ranks. The ranked medias which were
+		// equivalent keep being equivalent, only the added ones need to be compared
+		uint32_t rank = 0;
+		uint32_t previousRank = 0;
+		bool previousAdded = false;
+		m_Ranked.clear();
+		m_Ranked.reserve(ranked.size() + added.size());
+		auto append = [&] (int id, bool isAdded) {
+			if (m_Ranked.isEmpty() == false)
+			{
+				const bool equivalent = isAdded == false && previousAdded == false ?
+					m_Ranks[id] == previousRank :
+					this->CompareNames(m_Ranked.back(), id) == 0;
+				rank += equivalent == true ? 0 : 1;
+			}
+			previousRank = m_Ranks[id];
+			previousAdded = isAdded;
+			m_Ranks[id] = rank;
+			m_Ranked.push_back(id);
+		};
+
+		auto next = ranked.cbegin();
+		for (int index : qAsConst(order))
+		{
+			// added medias go after the ranked ones they're equivalent to
+			const int id = added[index];
+			const auto end = std::upper_bound(next, ranked.cend(), id, [this] (int left, int right) {
+				return this->CompareNames(left, right) < 0;
+			});
+			for (; next != end; ++next)
+			{
+				append(*next, false);
+			}
+			append(id, true);
+		}
+		for (; next != ranked.cend(); ++next)
+		{
+			append(*next, false);
+		}
+	}
+
+	//!
+	//! Find a media by name.
+	//!
+	//! @return
+	//!		The identifier of the media, or -1 if there's no media with this name.
+	//!
+	int MediaStore::Find(QStringView name) const
+	{
+		const uint hash = qHash(name);
+		for (auto id = m_Ids.constFind(hash); id != m_Ids.constEnd() && id.key() == hash; ++id)
+		{
+			if (this->GetName(id.value()) == name)
+			{
+				return id.value();
+			}
+		}
+		return -1;
+	}
+
+	//!
+	//! Remove the names of the removed medias from the arena
+	//!
+	void MediaStore::Compact(void)
+	{
+		QString names;
+		names.reserve(m_Names.size() - m_RemovedCharacters);
+		for (int id = 0; id < m_NameOffsets.size(); ++id)
+		{
+			const QStringView name = this->GetName(id);
+			m_NameOffsets[id] = static_cast< uint32_t >(names.size());
+			names.append(name.data(), name.size());
+		}
+		m_Names = names;
+		m_RemovedCharacters = 0;
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Media.h"
+
+#include <QCollator>
+#include <QMultiHash>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Compact storage of the medias of a folder.
+	//!
+	//! Medias are stored in columns indexed by a stable identifier: the names are packed in a single
+	//! string arena, and dates, sizes and types are stored as plain values. The folder is shared by
+	//! all the medias, so it's not stored at all. Identifiers of removed medias are reused, and the
+	//! arena is compacted when it contains more removed names than live ones.
+	//!
+	//! Names are compared with a collator (locale aware, with numbers compared by value). Each name
+	//! also gets, on demand, a rank: the position of the name in the collation order. Comparing
+	//! ranks is a plain integer comparison, which is what sorts and inserts use. The ranks are
+	//! updated incrementally: only the names added since the last update are sorted, with collation
+	//! keys that are released afterwards, and merged with the names already ranked.
+	//!
+	//! The identifiers are indexed by the hash of their name, to find medias by name in constant
+	//! time. Hashes are used instead of the names so that compacting the arena doesn't invalidate
+	//! the index.
+	//!
+	class MediaStore
+	{
+
+	public:
+
+		MediaStore(void);
+
+		// public API
+		int						Add(const QString & name, uint64_t size, int64_t date);
+		void					Remove(int id);
+		void					Clear(void);
+		int						Find(QStringView name) const;
+		inline int				GetCount(void) const;
+		inline int				GetCapacity(void) const;
+		inline QStringView		GetName(int id) const;
+		inline uint64_t			GetSize(int id) const;
+		inline int64_t			GetDate(int id) const;
+		inline Media::Type		GetType(int id) const;
+		inline int				CompareNames(int left, int right) const;
+		void					UpdateRanks(void);
+		inline uint32_t			GetRank(int id) const;
+
+	private:
+
+		void	Compact(void);
+
+		//! The names, end to end
+		QString m_Names;
+
+		//! Offset of the name of each media in m_Names
+		QVector< uint32_t > m_NameOffsets;
+
+		//! Length of the name of each media
+		QVector< uint32_t > m_NameLengths;
+
+		//! Size of each media, in bytes
+		QVector< uint64_t > m_Sizes;
+
+		//! Last modification date of each media, in milliseconds since epoch
+		QVector< int64_t > m_Dates;
+
+		//! Type of each media. NotSupported for removed medias
+		QVector< uint8_t > m_Types;
+
+		//! Rank of the name of each media in the collation order. Unranked for the medias added
+		//! since the last update
+		QVector< uint32_t > m_Ranks;
+
+		//! Identifiers sorted by name, as of the last update of the ranks. Might contain removed
+		//! medias, and identifiers reused since
+		QVector< int > m_Ranked;
+
+		//! Identifiers of the medias added since the last update of the ranks
+		QVector< int > m_Unranked;
+
+		//! Identifiers of the medias, by hash of their name
+		QMultiHash< uint, int > m_Ids;
+
+		//! Collator used to compare the names
+		QCollator m_Collator;
+
+		//! Identifiers of the removed medias, which can be reused
+		QVector< int > m_Free;
+
+		//! Number of characters of m_Names used by removed medias
+		int m_RemovedCharacters;
+
+	};
+
+} // namespace MediaViewer
+
+
+#include "MediaStore.inl"
@@ -0,0 +1,78 @@
+#pragma once
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Get the number of medias
+	//!
+	inline int MediaStore::GetCount(void) const
+	{
+		return m_Types.size() - m_Free.size();
+	}
+
+	//!
+	//! Get the number of identifiers in use, including the ones of removed medias. Identifiers are
+	//! always lower than this.
+	//!
+	inline int MediaStore::GetCapacity(void) const
+	{
+		return m_Types.size();
+	}
+
+	//!
+	//! Get the name of a media
+	//!
+	inline QStringView MediaStore::GetName(int id) const
+	{
+		return QStringView(m_Names).mid(m_NameOffsets[id], m_NameLengths[id]);
+	}
+
+	//!
+	//! Get the size of a media, in bytes
+	//!
+	inline uint64_t MediaStore::GetSize(int id) const
+	{
+		return m_Sizes[id];
+	}
+
+	//!
+	//! Get the last modification date of a media, in milliseconds since epoch
+	//!
+	inline int64_t MediaStore::GetDate(int id) const
+	{
+		return m_Dates[id];
+	}
+
+	//!
+	//! Get the type of a media
+	//!
+	inline Media::Type MediaStore::GetType(int id) const
+	{
+		return static_cast< Media::Type >(m_Types[id]);
+	}
+
+	//!
+	//! Compare the names of 2 medias in the collation order
+	//!
+	//! @return
+	//!		A negative value if the left name comes first, 0 if they're equivalent, and a positive
+	//!		value otherwise.
+	//!
+	inline int MediaStore::CompareNames(int left, int right) const
+	{
+		return m_Collator.compare(this->GetName(left), this->GetName(right));
+	}
+
+	//!
+	//! Get the rank of the name of a media in the collation order. Equivalent names have the same
+	//! rank. UpdateRanks must have been called since the last media was added.
+	//!
+	inline uint32_t MediaStore::GetRank(int id) const
+	{
+		Q_ASSERT(m_Unranked.isEmpty() == true);
+		return m_Ranks[id];
+	}
+
+}
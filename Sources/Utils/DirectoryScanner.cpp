@@ -0,0 +1,222 @@
+#include "DirectoryScanner.h"
+
+#include <QFile>
+
+#if defined(LINUX)
+#	include <dirent.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else
+#	include <QDateTime>
+#	include <QDir>
+#	include <QFileInfo>
+#endif
+
+
+namespace MediaViewer
+{
+
+#if defined(LINUX)
+
+	//!
+	//! Layout of the records returned by getdents64 (glibc doesn't expose it)
+	//!
+	struct LinuxDirent64
+	{
+		uint64_t		Inode;
+		int64_t			Offset;
+		unsigned short	Length;
+		unsigned char	Type;
+		char			Name[1];
+	};
+
+#endif
+
+	//!
+	//! Constructor. Opens the folder.
+	//!
+	DirectoryScanner::DirectoryScanner(const QString & path)
+		: m_Path(path)
+#if defined(LINUX)
+		, m_Descriptor(open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+#endif
+	{
+	}
+
+	//!
+	//! Destructor
+	//!
+	DirectoryScanner::~DirectoryScanner(void)
+	{
+#if defined(LINUX)
+		if (m_Descriptor != -1)
+		{
+			close(m_Descriptor);
+		}
+#endif
+	}
+
+	//!
+	//! Check if the folder could be opened
+	//!
+	bool DirectoryScanner::IsValid(void) const
+	{
+#if defined(LINUX)
+		return m_Descriptor != -1;
+#else
+		return QDir(m_Path).exists();
+#endif
+	}
+
+	//!
+	//! List the entries of the folder. Like QDir, hidden entries are skipped and symbolic links are
+	//! followed, and broken links are skipped.
+	//!
+	//! @param filters
+	//!		Combination of Filter flags.
+	//!
+	//! @param accept
+	//!		Optional function called with the name of each candidate entry. Entries for which it
+	//!		returns false are skipped without querying them.
+	//!
+	QVector< DirectoryScanner::Entry > DirectoryScanner::List(int filters, const std::function< bool (const QString &) > & accept) const
+	{
+		QVector< Entry > entries;
+#if defined(LINUX)
+		if (m_Descriptor == -1)
+		{
+			return entries;
+		}
+
+		// restart from the beginning, in case the folder is listed more than once
+		lseek(m_Descriptor, 0, SEEK_SET);
+
+		alignas(LinuxDirent64) char buffer[64 * 1024];
+		for (;;)
+		{
+			const long read = syscall(SYS_getdents64, m_Descriptor, buffer, sizeof(buffer));
+			if (read <= 0)
+			{
+				break;
+			}
+			for (long offset = 0; offset < read;)
+			{
+				const LinuxDirent64 * record = reinterpret_cast< const LinuxDirent64 * >(buffer + offset);
+				offset += record->Length;
+
+				// hidden entries, including . and ..
+				if (record->Name[0] == '.')
+				{
+					continue;
+				}
+
+				// filter on the type when it's known, and on the name before querying anything
+				bool directory = record->Type == DT_DIR;
+				const bool known = record->Type == DT_DIR || record->Type == DT_REG;
+				if (known == true && (filters & (directory == true ? Directories : Files)) == 0)
+				{
+					continue;
+				}
+				const QString name = QFile::decodeName(record->Name);
+				if (accept && accept(name) == false)
+				{
+					continue;
+				}
+
+				// links and unknown types need to be queried
+				if (known == false)
+				{
+					struct stat info;
+					if (fstatat(m_Descriptor, record->Name, &info, 0) != 0 ||
+						(S_ISDIR(info.st_mode) == false && S_ISREG(info.st_mode) == false))
+					{
+						continue;
+					}
+					directory = S_ISDIR(info.st_mode);
+					if ((filters & (directory == true ? Directories : Files)) == 0)
+					{
+						continue;
+					}
+				}
+
+				Entry entry;
+				entry.Name = name;
+				entry.Directory = directory;
+				entries.push_back(entry);
+			}
+		}
+#else
+		QDir::Filters qtFilters = QDir::NoDotAndDotDot;
+		if ((filters & Files) != 0)
+		{
+			qtFilters |= QDir::Files;
+		}
+		if ((filters & Directories) != 0)
+		{
+			qtFilters |= QDir::Dirs;
+		}
+		for (const QFileInfo & info : QDir(m_Path).entryInfoList(qtFilters, QDir::NoSort))
+		{
+			if (accept && accept(info.fileName()) == false)
+			{
+				continue;
+			}
+			Entry entry;
+			entry.Name = info.fileName();
+			entry.Directory = info.isDir();
+			entry.Stated = true;
+			entry.Size = info.size();
+			entry.Date = info.lastModified().toMSecsSinceEpoch();
+			entries.push_back(entry);
+		}
+#endif
+		return entries;
+	}
+
+	//!
+	//! Get the size and date of an entry, if they're not already known
+	//!
+	//! @return
+	//!		false if the entry couldn't be queried.
+	//!
+	bool DirectoryScanner::Stat(Entry & entry) const
+	{
+		if (entry.Stated == true)
+		{
+			return true;
+		}
+#if defined(LINUX)
+		const QByteArray name = QFile::encodeName(entry.Name);
+#	if defined(STATX_SIZE)
+		struct statx info;
+		if (statx(m_Descriptor, name.constData(), AT_STATX_SYNC_AS_STAT, STATX_SIZE | STATX_MTIME, &info) != 0)
+		{
+			return false;
+		}
+		entry.Size = static_cast< int64_t >(info.stx_size);
+		entry.Date = static_cast< int64_t >(info.stx_mtime.tv_sec) * 1000 + info.stx_mtime.tv_nsec / 1000000;
+#	else
+		struct stat info;
+		if (fstatat(m_Descriptor, name.constData(), &info, 0) != 0)
+		{
+			return false;
+		}
+		entry.Size = static_cast< int64_t >(info.st_size);
+		entry.Date = static_cast< int64_t >(info.st_mtim.tv_sec) * 1000 + info.st_mtim.tv_nsec / 1000000;
+#	endif
+#else
+		const QFileInfo info(m_Path + "/" + entry.Name);
+		if (info.exists() == false)
+		{
+			return false;
+		}
+		entry.Size = info.size();
+		entry.Date = info.lastModified().toMSecsSinceEpoch();
+#endif
+		entry.Stated = true;
+		return true;
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Lists the content of a folder, querying the files only when needed.
+	//!
+	//! On Linux, entries are read with getdents64 and their type comes from d_type, so listing a
+	//! folder doesn't query any file (except symbolic links and file systems which don't report
+	//! types). The size and date of an entry are then queried with statx, relative to the open
+	//! folder, only for the entries which are needed. Other platforms use QDir, where listing a
+	//! folder already returns those information.
+	//!
+	class DirectoryScanner
+	{
+
+	public:
+
+		//! What to list
+		enum Filter
+		{
+			Files		= 1 << 0,
+			Directories	= 1 << 1,
+		};
+
+		//!
+		//! An entry of the folder
+		//!
+		struct Entry
+		{
+			//! Name of the entry
+			QString Name;
+
+			//! True for folders
+			bool Directory = false;
+
+			//! True when Size and Date are valid
+			bool Stated = false;
+
+			//! Size in bytes
+			int64_t Size = 0;
+
+			//! Last modification date, in milliseconds since epoch
+			int64_t Date = 0;
+		};
+
+		DirectoryScanner(const QString & path);
+		~DirectoryScanner(void);
+
+		// public API
+		bool				IsValid(void) const;
+		QVector< Entry >	List(int filters, const std::function< bool (const QString &) > & accept = nullptr) const;
+		bool				Stat(Entry & entry) const;
+
+	private:
+
+		//! The folder
+		QString m_Path;
+
+#if defined(LINUX)
+		//! Descriptor of the open folder
+		int m_Descriptor;
+#endif
+
+	};
+
+} // namespace MediaViewer
@@ -1,7 +1,5 @@
 #include "./Job.h"
 
-#include <QThreadPool>
-
 
 namespace MediaViewer
 {
@@ -12,10 +10,13 @@ namespace MediaViewer
 	//! @param job
 	//!		The job to execute.
 	//!
-	Job::Job(const std::function< void (void) > & job)
+	//! @param pool
+	//!		The thread pool in which the job will be executed.
+	//!
+	Job::Job(const std::function< void (void) > & job, QThreadPool * pool)
 		: m_Job(job)
 	{
-		QThreadPool::globalInstance()->start(this);
+		pool->start(this);
 	}
 
 	//!
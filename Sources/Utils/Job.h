@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QRunnable>
+#include <QThreadPool>
 
 
 namespace MediaViewer
@@ -17,7 +18,7 @@ namespace MediaViewer
 
 	public:
 
-		Job(const std::function< void (void) > & job);
+		Job(const std::function< void (void) > & job, QThreadPool * pool = QThreadPool::globalInstance());
 
 	protected:
 
@@ -0,0 +1,57 @@
+#include "ParallelSort.h"
+#include "Job.h"
+#include "CppUtils/MemoryTracker.h"
+
+#include <QSemaphore>
+
+#include <atomic>
+#include <memory>
+
+
+namespace MediaViewer
+{
+
+	//!
+	//! Run tasks in parallel, and wait for all of them to complete.
+	//!
+	//! The tasks are picked by the pool's threads and by the calling thread. Jobs which start after
+	//! all the tasks were picked return immediately, so this never waits for a busy pool.
+	//!
+	//! @param count
+	//!		The number of tasks.
+	//!
+	//! @param task
+	//!		The task, called with indices from 0 to count - 1.
+	//!
+	//! @param pool
+	//!		The pool helping the calling thread.
+	//!
+	void ParallelFor(int count, const std::function< void (int) > & task, QThreadPool * pool)
+	{
+		// shared with the jobs, which might outlive this call
+		struct State
+		{
+			std::atomic_int Next { 0 };
+			QSemaphore Done;
+			std::function< void (int) > Task;
+		};
+		auto state = std::make_shared< State >();
+		state->Task = task;
+
+		auto work = [state, count] (void) {
+			for (int i = state->Next++; i < count; i = state->Next++)
+			{
+				state->Task(i);
+				state->Done.release();
+			}
+		};
+
+		for (int i = 1; i < qMin(count, pool->maxThreadCount() + 1); ++i)
+		{
+			MT_NEW Job(work, pool);
+		}
+		work();
+		state->Done.acquire(count);
+	}
+
+} // namespace MediaViewer
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QThreadPool>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+namespace MediaViewer
+{
+
+	void	ParallelFor(int count, const std::function< void (int) > & task, QThreadPool * pool = QThreadPool::globalInstance());
+
+	//!
+	//! Stable sort, using the threads of a pool.
+	//!
+	//! The range is split in chunks which are sorted in parallel, then merged pairwise, each round
+	//! of merges also running in parallel. The comparison is a template parameter, so it's inlined
+	//! in the sort and the merges.
+	//!
+	//! @param first
+	//!		The first element to sort.
+	//!
+	//! @param count
+	//!		The number of elements to sort.
+	//!
+	//! @param compare
+	//!		Strict weak ordering of the elements.
+	//!
+	//! @param pool
+	//!		The pool used to sort the chunks. The calling thread also takes part in the sort, so it
+	//!		completes even if the pool is busy.
+	//!
+	template< typename T, typename Compare >
+	void ParallelStableSort(T * first, int count, Compare compare, QThreadPool * pool = QThreadPool::globalInstance())
+	{
+		// below that, the threads cost more than they save
+		constexpr int MinChunkSize = 16384;
+
+		int chunks = 1;
+		while (chunks * 2 <= pool->maxThreadCount() + 1 && count / (chunks * 2) >= MinChunkSize)
+		{
+			chunks *= 2;
+		}
+		if (chunks == 1)
+		{
+			std::stable_sort(first, first + count, compare);
+			return;
+		}
+
+		// chunk i is [bounds[i], bounds[i + 1])
+		std::vector< int > bounds(chunks + 1);
+		for (int i = 0; i <= chunks; ++i)
+		{
+			bounds[i] = static_cast< int >(static_cast< int64_t >(count) * i / chunks);
+		}
+
+		ParallelFor(chunks, [&] (int chunk) {
+			std::stable_sort(first + bounds[chunk], first + bounds[chunk + 1], compare);
+		}, pool);
+
+		// merge pairs of runs back and forth between the range and a buffer. On ties std::merge
+		// takes the element from the first run, which keeps the sort stable
+		std::vector< T > buffer(first, first + count);
+		T * source = first;
+		T * destination = buffer.data();
+		for (int width = 1; width < chunks; width *= 2)
+		{
+			ParallelFor(chunks / (width * 2), [&] (int merge) {
+				const int begin = bounds[merge * width * 2];
+				const int middle = bounds[merge * width * 2 + width];
+				const int end = bounds[merge * width * 2 + width * 2];
+				std::merge(
+					std::make_move_iterator(source + begin), std::make_move_iterator(source + middle),
+					std::make_move_iterator(source + middle), std::make_move_iterator(source + end),
+					destination + begin,
+					compare
+				);
+			}, pool);
+			std::swap(source, destination);
+		}
+		if (source != first)
+		{
+			std::move(source, source + count, first);
+		}
+	}
+
+} // namespace MediaViewer